@@ -0,0 +1,148 @@
+/*************************************************************************
+    > File Name: batch_scheduler.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月12日 星期四 11时05分40秒
+ ************************************************************************/
+#include "batch_scheduler.h"
+#include <algorithm>
+
+BatchScheduler::BatchScheduler(std::shared_ptr<const TtsModel> model)
+    : _model(std::move(model)),
+      _window(_model->_config.batch_window_ms) {
+  const TtsModel &m = *_model;
+  _max_batch = 1;
+  if (m._batch_capable) {
+    _max_batch = std::max(1, std::min(m._config.max_batch_size, m._max_batch_size));
+  } else if (m._config.max_batch_size > 1) {
+    std::cout << "kokoro model has no batch support, run one by one" << std::endl;
+  }
+  size_t num_workers = std::max<size_t>(1, m._sessions->size());
+  for (size_t i = 0; i < num_workers; ++i) {
+    _workers.emplace_back(&BatchScheduler::worker, this);
+  }
+}
+
+BatchScheduler::~BatchScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _cond.notify_all();
+  for (auto &t : _workers) {
+    t.join();
+  }
+}
+
+std::future<std::vector<float>>
+BatchScheduler::submit(std::vector<int64_t> token_ids, const std::string &voice,
+                       float speed, CancellationToken *cancel) {
+  Request request;
+  request.style = _model->styleFor(voice, token_ids.size());
+  request.token_ids = std::move(token_ids);
+  request.speed = speed;
+  request.cancel = cancel;
+  request.arrival = std::chrono::steady_clock::now();
+  auto future = request.promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.push_back(std::move(request));
+    ++_stats.requests;
+  }
+  // wake the worker collecting a batch as well as the idle ones
+  _cond.notify_all();
+  return future;
+}
+
+BatchScheduler::Stats BatchScheduler::stats() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+void BatchScheduler::worker() {
+  _model->_config.pinWorkerThread();
+  TtsContext context(_model);
+  std::vector<Request> batch;
+  while (true) {
+    batch.clear();
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (true) {
+        _cond.wait(lock, [this] { return _stop || !_queue.empty(); });
+        if (_queue.empty()) {
+          return; // stopped and drained
+        }
+        auto deadline = _queue.front().arrival + _window;
+        _cond.wait_until(lock, deadline, [this] {
+          return _stop || _queue.empty() || _queue.size() >= _max_batch;
+        });
+        // another worker may have taken the queue meanwhile
+        if (!_queue.empty()) {
+          break;
+        }
+      }
+      // dead requests do not take a slot of the batch
+      while (!_queue.empty() && batch.size() < _max_batch) {
+        Request &r = _queue.front();
+        if (r.cancel != nullptr && r.cancel->cancelled()) {
+          r.promise.set_exception(std::make_exception_ptr(TtsCancelled()));
+          ++_stats.cancelled;
+        } else {
+          batch.push_back(std::move(r));
+        }
+        _queue.pop_front();
+      }
+      if (batch.empty()) {
+        continue;
+      }
+      ++_stats.batches;
+      _stats.max_batch = std::max(_stats.max_batch, batch.size());
+    }
+    runBatch(context, batch);
+  }
+}
+
+void BatchScheduler::runBatch(TtsContext &context, std::vector<Request> &batch) {
+  const TtsModel &model = *_model;
+  int64_t emb_dim = model._style_dims[2];
+  try {
+    if (batch.size() == 1) {
+      Request &r = batch.front();
+      std::vector<float> audio;
+      context.infer(r.token_ids.data(), r.token_ids.size(), r.style, r.speed, audio,
+                    r.cancel);
+      r.promise.set_value(std::move(audio));
+      return;
+    }
+
+    size_t max_len = 0;
+    for (auto &r : batch) {
+      max_len = std::max(max_len, r.token_ids.size());
+    }
+    std::vector<int64_t> token_ids(batch.size() * max_len, 0); // 0 pads
+    std::vector<size_t> lengths;
+    std::vector<float> styles;
+    std::vector<float> speeds;
+    for (size_t b = 0; b < batch.size(); ++b) {
+      auto &r = batch[b];
+      std::copy(r.token_ids.begin(), r.token_ids.end(),
+                token_ids.begin() + b * max_len);
+      lengths.push_back(r.token_ids.size());
+      styles.insert(styles.end(), r.style, r.style + emb_dim);
+      speeds.push_back(r.speed);
+    }
+    std::vector<std::vector<float>> audio;
+    context.inferBatch(token_ids, lengths, styles, speeds, audio);
+    for (size_t b = 0; b < batch.size(); ++b) {
+      batch[b].promise.set_value(std::move(audio[b]));
+    }
+  } catch (...) {
+    for (auto &r : batch) {
+      try {
+        r.promise.set_exception(std::current_exception());
+      } catch (const std::future_error &) {
+        // value already set
+      }
+    }
+  }
+}
@@ -0,0 +1,72 @@
+/*************************************************************************
+    > File Name: batch_scheduler.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月12日 星期四 11时05分16秒
+ ************************************************************************/
+#pragma once
+#include "kokoro.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Dynamic batching of kokoro inference across concurrent requests.
+// submit() queues an utterance, a worker waits at most batch_window_ms after
+// the oldest queued utterance for more to arrive, pads up to max_batch_size of
+// them into one [B, T] run and cuts the audio back per request with the
+// predicted durations. One worker per session of the model pool.
+// If the model was not exported with batch support every utterance is run
+// on its own, the scheduler then only serializes the requests onto the pool.
+class BatchScheduler {
+public:
+  struct Stats {
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    uint64_t cancelled = 0; // dropped from the queue
+    size_t max_batch = 0;
+  };
+
+  explicit BatchScheduler(std::shared_ptr<const TtsModel> model);
+  ~BatchScheduler();
+  BatchScheduler(const BatchScheduler &) = delete;
+  BatchScheduler &operator=(const BatchScheduler &) = delete;
+
+  // token_ids as produced by TtsContext::tokenize.
+  // A request whose token is cancelled (or past its deadline) while it waits
+  // is dropped from the queue, its future throws TtsCancelled. Once in a
+  // batch of several it runs to the end, a batch of one is terminated.
+  std::future<std::vector<float>> submit(std::vector<int64_t> token_ids,
+                                         const std::string &voice,
+                                         float speed = 0.85f,
+                                         CancellationToken *cancel = nullptr);
+  Stats stats() const;
+  bool batching() const { return _max_batch > 1; }
+
+private:
+  struct Request {
+    std::vector<int64_t> token_ids;
+    const float *style;
+    float speed;
+    CancellationToken *cancel;
+    std::chrono::steady_clock::time_point arrival;
+    std::promise<std::vector<float>> promise;
+  };
+  void worker();
+  void runBatch(TtsContext &context, std::vector<Request> &batch);
+
+  std::shared_ptr<const TtsModel> _model;
+  size_t _max_batch;
+  std::chrono::milliseconds _window;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _cond;
+  std::deque<Request> _queue;
+  bool _stop = false;
+  Stats _stats;
+  std::vector<std::thread> _workers;
+};
@@ -0,0 +1,75 @@
+/*************************************************************************
+    > File Name: bench_alloc.cc
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月05日 星期六 10时18分44秒
+ ************************************************************************/
+// Heap allocations of the front end (text -> token id chunks, as run() does
+// before inference) per request. The first request of a context grows its
+// scratch buffers, later ones should reuse them: english and punctuation take
+// no allocation in steady state, the hanzi runs only the ones inside jieba,
+// or none once they are in the G2pCache (pass 0 as cache bytes to see jieba).
+//
+// usage: ./bin/bench_alloc [requests per sentence, default 100]
+//        [g2p cache bytes, default TtsConfig::g2p_cache_bytes]
+#include "bench_util.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+static std::atomic<size_t> g_allocations{0};
+
+void *operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main(int argc, char *argv[]) {
+  int requests = argc > 1 ? atoi(argv[1]) : 100;
+  TtsConfig config;
+  if (argc > 2) {
+    config.g2p_cache_bytes = atol(argv[2]);
+  }
+  auto model = bench::loadModel(config);
+  TtsContext context(model);
+
+  std::vector<std::string> texts = bench::sentences();
+  texts.push_back("Hello, how are you doing today? Fine, thank you!");
+
+  // the front end logs every segment, keep it out of the numbers
+  std::streambuf *cout_buf = std::cout.rdbuf(nullptr);
+  std::vector<std::vector<int64_t>> chunks;
+  std::vector<size_t> first(texts.size()), steady(texts.size());
+  std::vector<double> us(texts.size());
+  for (size_t t = 0; t < texts.size(); ++t) {
+    size_t before = g_allocations;
+    context.tokenizeChunks(texts[t], chunks);
+    first[t] = g_allocations - before;
+
+    before = g_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < requests; ++r) {
+      context.tokenizeChunks(texts[t], chunks);
+    }
+    us[t] = bench::elapsedMs(start) * 1000 / requests;
+    steady[t] = g_allocations - before;
+  }
+  std::cout.rdbuf(cout_buf);
+  std::cout.clear();
+
+  printf("%-8s %12s %14s %10s\n", "bytes", "first alloc", "steady alloc", "us");
+  for (size_t t = 0; t < texts.size(); ++t) {
+    printf("%-8zu %12zu %14.1f %10.1f\n", texts[t].size(), first[t],
+           steady[t] / (double)requests, us[t]);
+  }
+  if (model->_g2p_cache) {
+    printf("%s\n", model->_g2p_cache->stats().toString().c_str());
+  }
+  return 0;
+}
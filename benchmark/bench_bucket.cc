@@ -0,0 +1,93 @@
+/*************************************************************************
+    > File Name: bench_bucket.cc
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月16日 星期一 09时58分30秒
+ ************************************************************************/
+// Latency and memory growth of varied-length requests, with and without
+// padding the tokens to TtsConfig::bucket_lengths. Needs a model exported
+// with the 'durations' output, else there is no bucketing to measure.
+// kokoro has no attention mask, the real tokens also attend to the padding,
+// so the padded audio is compared with the unpadded one per utterance:
+// length difference and rms of the difference over the common part.
+//
+// usage: ./bin/bench_bucket [iterations] [buckets, default 32,64,128,256,510]
+#include "bench_util.h"
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+// reference: audio of every utterance without padding, filled when empty
+static void run(const char *name, const TtsConfig &config, int iterations,
+                std::vector<std::vector<float>> &reference) {
+  auto model = bench::loadModel(config);
+  if (!config.bucket_lengths.empty() && !model->_bucketing) {
+    printf("bucketing is off: the model has no 'durations' output, export it "
+           "with one to compare\n");
+    exit(1);
+  }
+  TtsContext context(model);
+
+  std::vector<std::vector<int64_t>> utterances;
+  for (auto &s : bench::sentences()) {
+    utterances.emplace_back();
+    context.tokenize(s, utterances.back());
+  }
+
+  std::vector<float> audio;
+  // one pass to load the weights, then measure from there
+  bool compare = !reference.empty();
+  for (size_t u = 0; u < utterances.size(); ++u) {
+    auto &ids = utterances[u];
+    audio.clear();
+    context.infer(ids.data(), ids.size(), model->styleFor("zf_001", ids.size()), 1.0f, audio);
+    if (!compare) {
+      reference.push_back(audio);
+      continue;
+    }
+    const std::vector<float> &ref = reference[u];
+    size_t n = std::min(ref.size(), audio.size());
+    double sum = 0, ref_sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += (audio[i] - ref[i]) * (audio[i] - ref[i]);
+      ref_sum += ref[i] * ref[i];
+    }
+    printf("tokens %4zu  samples %+8ld  diff rms %.5f (signal rms %.5f)\n", ids.size(),
+           (long)audio.size() - (long)ref.size(), n ? sqrt(sum / n) : 0.0,
+           n ? sqrt(ref_sum / n) : 0.0);
+  }
+  double rss_start = bench::rssMb();
+
+  std::mt19937 rng(20250616);
+  std::vector<double> latency;
+  for (int i = 0; i < iterations; ++i) {
+    auto &ids = utterances[rng() % utterances.size()];
+    audio.clear();
+    auto start = std::chrono::steady_clock::now();
+    context.infer(ids.data(), ids.size(), model->styleFor("zf_001", ids.size()), 1.0f, audio);
+    latency.push_back(bench::elapsedMs(start));
+  }
+  double rss_end = bench::rssMb();
+
+  printf("%-10s p50 %8.2f ms  p99 %8.2f ms  rss %8.1f MB -> %8.1f MB (+%.1f MB)\n",
+         name, bench::percentile(latency, 50), bench::percentile(latency, 99),
+         rss_start, rss_end, rss_end - rss_start);
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 200;
+  std::string buckets = argc > 2 ? argv[2] : "32,64,128,256,510";
+
+  TtsConfig config = TtsConfig::LowLatency();
+  std::vector<std::vector<float>> reference;
+  run("no-bucket", config, iterations, reference);
+
+  std::stringstream ss(buckets);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    config.bucket_lengths.push_back(std::stoi(item));
+  }
+  run("bucket", config, iterations, reference);
+  return 0;
+}
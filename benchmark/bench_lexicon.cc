@@ -0,0 +1,101 @@
+/*************************************************************************
+    > File Name: bench_lexicon.cc
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月03日 星期四 10时31分52秒
+ ************************************************************************/
+// Word lookups in the lexicons (lexicon-zh, lexicon-us-en) with std::map
+// against StringMap. The probe words are every word of the lexicons in a
+// shuffled order plus as many misses, as the front end looks up whole jieba
+// words first and falls back to single hanzi when they are missing.
+//
+// usage: ./bin/bench_lexicon [rounds, default 5]
+#include "bench_util.h"
+#include "string_map.h"
+#include <map>
+#include <random>
+#include <sstream>
+
+using Tokens = std::vector<std::string>;
+
+static void load(const std::vector<std::string> &files, std::vector<std::string> &words,
+                 std::vector<Tokens> &tokens) {
+  for (auto &fin : files) {
+    std::ifstream input(fin);
+    std::string line;
+    while (std::getline(input, line)) {
+      std::istringstream ss(line);
+      std::string word, token;
+      ss >> word;
+      Tokens t;
+      while (ss >> token) {
+        t.push_back(token);
+      }
+      words.push_back(word);
+      tokens.push_back(std::move(t));
+    }
+  }
+}
+
+template <typename F>
+static double nsPerLookup(const std::vector<std::string> &probes, int rounds, F lookup) {
+  size_t found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; ++r) {
+    for (auto &p : probes) {
+      found += lookup(p);
+    }
+  }
+  double ms = bench::elapsedMs(start);
+  // keep the lookups from being optimized out
+  if (found == 0) {
+    printf("no word found\n");
+  }
+  return ms * 1e6 / (probes.size() * (double)rounds);
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 5;
+  bench::ModelFiles files;
+
+  std::vector<std::string> words;
+  std::vector<Tokens> tokens;
+  load(files.lexicons(), words, tokens);
+  if (words.empty()) {
+    printf("no lexicon found in %s\n", files.model_dir.c_str());
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::map<std::string, Tokens> tree;
+  for (size_t i = 0; i < words.size(); ++i) {
+    tree[words[i]] = tokens[i];
+  }
+  double tree_build = bench::elapsedMs(start);
+
+  start = std::chrono::steady_clock::now();
+  StringMap<Tokens> table;
+  table.reserve(words.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    table[words[i]] = tokens[i];
+  }
+  double table_build = bench::elapsedMs(start);
+
+  std::vector<std::string> probes = words;
+  for (auto &w : words) {
+    probes.push_back(w + "#"); // a miss with the same prefix
+  }
+  std::shuffle(probes.begin(), probes.end(), std::mt19937(20250703));
+
+  double tree_ns = nsPerLookup(probes, rounds, [&](const std::string &w) {
+    return tree.find(w) != tree.end();
+  });
+  double table_ns = nsPerLookup(probes, rounds, [&](const std::string &w) {
+    return table.find(w) != nullptr;
+  });
+
+  printf("%zu words, %zu probes x %d rounds\n", tree.size(), probes.size(), rounds);
+  printf("std::map   build %8.1f ms  lookup %7.1f ns\n", tree_build, tree_ns);
+  printf("StringMap  build %8.1f ms  lookup %7.1f ns\n", table_build, table_ns);
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*************************************************************************
+    > File Name: bench_modes.cc
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月01日 星期二 15时12分26秒
+ ************************************************************************/
+// Latency against throughput of TtsConfig::kLatency and kThroughput: every
+// mode is loaded once and driven by 1, 2, 4, ... concurrent clients, each
+// sending requests back to back through the serving paths the mode sets up:
+//   batch  token ids through a BatchScheduler (max_batch_size, batch_window_ms)
+//   async  text through the TtsExecutor of Tts::runAsync (async_workers,
+//          async_queue_depth), a rejected request is retried after 1 ms
+// Prints per request p50/p99 latency, requests per second and seconds of
+// audio per second for every point, with the batch sizes and rejections.
+//
+// usage: ./bin/bench_modes [requests per client, default 20] [max clients,
+//        default number of cores] [throughput sessions, default one per core]
+#include "batch_scheduler.h"
+#include "bench_util.h"
+#include "tts_executor.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// request(client, i) runs one request and returns its number of samples
+template <typename F>
+static void clients(const char *name, const char *path, int clients, int requests,
+                    int sample_rate, F request) {
+  std::vector<double> latency;
+  std::atomic<size_t> samples{0};
+  std::mutex mutex;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < clients; ++c) {
+    threads.emplace_back([&, c] {
+      std::vector<double> mine;
+      for (int i = 0; i < requests; ++i) {
+        auto t = std::chrono::steady_clock::now();
+        samples += request(c, i);
+        mine.push_back(bench::elapsedMs(t));
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      latency.insert(latency.end(), mine.begin(), mine.end());
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  double seconds = bench::elapsedMs(start) / 1000;
+  printf("%-10s %-5s clients %3d  p50 %8.2f ms  p99 %8.2f ms  %7.2f req/s  %7.2f audio s/s",
+         name, path, clients, bench::percentile(latency, 50), bench::percentile(latency, 99),
+         latency.size() / seconds, samples / (double)sample_rate / seconds);
+}
+
+static void run(const char *name, const TtsConfig &config, int requests,
+                int max_clients) {
+  auto model = bench::loadModel(config);
+  const std::vector<std::string> &texts = bench::sentences();
+  std::vector<std::vector<int64_t>> utterances;
+  {
+    TtsContext context(model);
+    for (auto &s : texts) {
+      utterances.emplace_back();
+      context.tokenize(s, utterances.back());
+    }
+    // load the weights before measuring
+    std::vector<float> audio;
+    for (auto &ids : utterances) {
+      context.infer(ids.data(), ids.size(), model->styleFor("zf_001", ids.size()), 1.0f, audio);
+    }
+  }
+
+  for (int n = 1; n <= max_clients; n *= 2) {
+    BatchScheduler scheduler(model);
+    clients(name, "batch", n, requests, model->_sample_rate, [&](int c, int i) {
+      auto &ids = utterances[(c + i) % utterances.size()];
+      return scheduler.submit(ids, "zf_001", 1.0f).get().size();
+    });
+    auto stats = scheduler.stats();
+    printf("  batches %llu max batch %zu\n", (unsigned long long)stats.batches,
+           stats.max_batch);
+  }
+
+  for (int n = 1; n <= max_clients; n *= 2) {
+    TtsExecutor executor(model);
+    clients(name, "async", n, requests, model->_sample_rate, [&](int c, int i) {
+      const std::string &text = texts[(c + i) % texts.size()];
+      while (true) {
+        auto audio = executor.runAsync(text, "zf_001");
+        try {
+          return audio.get().size();
+        } catch (const TtsQueueFull &) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+    });
+    printf("  workers %zu rejected %llu\n", executor.workers(),
+           (unsigned long long)executor.stats().rejected);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int requests = argc > 1 ? atoi(argv[1]) : 20;
+  int max_clients = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+  int sessions = argc > 3 ? atoi(argv[3]) : 0;
+  max_clients = std::max(1, max_clients);
+
+  run("latency", TtsConfig::ForMode(TtsConfig::kLatency), requests, max_clients);
+  run("throughput", TtsConfig::ForMode(TtsConfig::kThroughput, sessions), requests,
+      max_clients);
+  return 0;
+}
@@ -0,0 +1,76 @@
+/*************************************************************************
+    > File Name: bench_util.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月16日 星期一 09时41分12秒
+ ************************************************************************/
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "kokoro.h"
+
+namespace bench {
+
+struct ModelFiles {
+  std::string model_dir = "./model/";
+  std::string jieba_dir = "./dict/";
+
+  std::string kokoro_onnx() const { return model_dir + "/kokoro.onnx"; }
+  std::string tokens() const { return model_dir + "/tokens.txt"; }
+  std::vector<std::string> lexicons() const {
+    return {model_dir + "/lexicon-us-en.txt", model_dir + "/lexicon-zh.txt"};
+  }
+  std::string voices() const { return model_dir + "/voices.bin"; }
+};
+
+inline std::shared_ptr<const TtsModel> loadModel(const TtsConfig &config,
+                                                 const ModelFiles &files = ModelFiles()) {
+  return std::make_shared<const TtsModel>(files.kokoro_onnx(), files.tokens(),
+                                          files.lexicons(), files.voices(),
+                                          files.jieba_dir, config);
+}
+
+// utterances of very different lengths, as seen by a long running worker
+inline const std::vector<std::string> &sentences() {
+  static const std::vector<std::string> s = {
+      "你好。",
+      "欢迎致电，请问有什么可以帮您？",
+      "How are you doing today?",
+      "王楚钦延续火热的竞技状态，比赛上来连赢七分势不可挡。",
+      "来听一听，这个是什么口音？How are you doing? Are you ok? Thank you!",
+      "莱昂纳多完全被牵制，根本不能发挥自身的优势特点，尝试的变化都无功而返，次局连续遭遇压制心态受到影响。",
+      "邱党世界排名第十一，作为本届世乒赛男单的十号种子，个人状态属实不太理想，首轮鏖战七局惊险过关，"
+      "来到次轮又是极其慢热，前三局比分非常激烈，但关键时刻屡屡掉链子，绝境局面触底反弹，一度看到超级逆转的希望。",
+  };
+  return s;
+}
+
+inline double percentile(std::vector<double> v, double p) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  size_t i = std::min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+  return v[i];
+}
+
+// resident set size in MB
+inline double rssMb() {
+  std::ifstream statm("/proc/self/statm");
+  long pages = 0, resident = 0;
+  statm >> pages >> resident;
+  return resident * (double)sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+inline double elapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace bench
@@ -0,0 +1,237 @@
+/*************************************************************************
+    > File Name: binary_lexicon.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月04日 星期五 14时03分26秒
+ ************************************************************************/
+#include "binary_lexicon.h"
+#include "string_map.h"
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+static std::string_view strip_cr(std::string_view line) {
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  return line;
+}
+
+bool parse_lexicon_line(std::string_view line, std::string_view &word,
+                        std::vector<std::string_view> &tokens) {
+  line = strip_cr(line);
+  tokens.clear();
+  bool first = true;
+  size_t i = 0;
+  while (true) {
+    size_t begin = line.find_first_not_of(" \t", i);
+    if (begin == std::string_view::npos) {
+      break;
+    }
+    size_t end = std::min(line.find_first_of(" \t", begin), line.size());
+    std::string_view field = line.substr(begin, end - begin);
+    if (first) {
+      word = field;
+      first = false;
+    } else {
+      tokens.push_back(field);
+    }
+    i = end;
+  }
+  return !first;
+}
+
+bool parse_tokens_line(std::string_view line, std::string_view &token, int32_t &id) {
+  line = strip_cr(line);
+  size_t sep = line.find_last_of(" \t");
+  if (sep == std::string_view::npos || sep + 1 == line.size()) {
+    return false;
+  }
+  auto result = std::from_chars(line.data() + sep + 1, line.data() + line.size(), id);
+  if (result.ec != std::errc() || result.ptr != line.data() + line.size()) {
+    return false;
+  }
+  token = line.substr(0, sep);
+  return true;
+}
+
+uint64_t BinaryLexicon::tokensChecksum(const std::string &tokens_file) {
+  std::ifstream input(tokens_file, std::ios::binary);
+  if (!input) {
+    throw std::runtime_error("fail to open " + tokens_file);
+  }
+  std::stringstream ss;
+  ss << input.rdbuf();
+  return hash_string(ss.str());
+}
+
+BinaryLexicon::BinaryLexicon(const std::string &path, const std::string &tokens_file)
+    : _file(path) {
+  const char *data = static_cast<const char *>(_file.data());
+  if (_file.size() < sizeof(Header)) {
+    throw std::runtime_error(path + " is not a binary lexicon");
+  }
+  _header = reinterpret_cast<const Header *>(data);
+  if (memcmp(_header->magic, "KLEX", 4) != 0 || _header->version != kVersion) {
+    throw std::runtime_error(path + " is not a binary lexicon of version " +
+                             std::to_string(kVersion));
+  }
+  uint64_t expected = sizeof(Header) + (uint64_t)_header->num_slots * sizeof(Slot) +
+                      _header->keys_size + (uint64_t)_header->num_ids * sizeof(int32_t);
+  // num_slots must be a power of two for the probing mask, with a free slot
+  // to end the probing of a miss, and the keys padded for the int32 ids
+  if (_file.size() < expected || _header->num_slots == 0 ||
+      (_header->num_slots & (_header->num_slots - 1)) != 0 ||
+      _header->num_words >= _header->num_slots || _header->keys_size % 4 != 0) {
+    throw std::runtime_error(path + " is truncated or corrupt");
+  }
+  if (_header->tokens_checksum != tokensChecksum(tokens_file)) {
+    throw std::runtime_error(path + " was compiled for another " + tokens_file +
+                             ", run tools/compile_lexicon again");
+  }
+  _slots = reinterpret_cast<const Slot *>(data + sizeof(Header));
+  _keys = reinterpret_cast<const char *>(_slots + _header->num_slots);
+  // the keys are padded to 4 bytes, see compile()
+  _ids = reinterpret_cast<const int32_t *>(_keys + _header->keys_size);
+
+  // checked once here, find() trusts the slots
+  size_t used = 0;
+  for (uint32_t i = 0; i < _header->num_slots; ++i) {
+    const Slot &slot = _slots[i];
+    if (slot.ids_offset == kEmpty) {
+      continue;
+    }
+    ++used;
+    if ((uint64_t)slot.key_offset + slot.key_size > _header->keys_size ||
+        (uint64_t)slot.ids_offset + slot.num_ids > _header->num_ids) {
+      throw std::runtime_error(path + " is corrupt, slot " + std::to_string(i) +
+                               " points out of the file");
+    }
+  }
+  if (used != _header->num_words) {
+    throw std::runtime_error(path + " is corrupt, " + std::to_string(used) +
+                             " slots used for " + std::to_string(_header->num_words) + " words");
+  }
+}
+
+bool BinaryLexicon::find(std::string_view word, const int32_t *&ids,
+                         size_t &num_ids) const {
+  uint64_t hash = hash_string(word);
+  size_t mask = _header->num_slots - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot &slot = _slots[i];
+    if (slot.ids_offset == kEmpty) {
+      return false;
+    }
+    if (slot.hash == (uint32_t)hash && slot.key_size == word.size() &&
+        memcmp(_keys + slot.key_offset, word.data(), word.size()) == 0) {
+      ids = _ids + slot.ids_offset;
+      num_ids = slot.num_ids;
+      return true;
+    }
+  }
+}
+
+void BinaryLexicon::compile(const std::vector<std::string> &lexicons,
+                            const std::string &tokens_file,
+                            const std::string &out_file) {
+  // parsed like TtsModel::load_tokens and load_lexicons
+  StringMap<int32_t> token2id;
+  {
+    std::ifstream input(tokens_file);
+    if (!input) {
+      throw std::runtime_error("fail to open " + tokens_file);
+    }
+    std::string line;
+    std::string_view token;
+    int32_t id;
+    while (std::getline(input, line)) {
+      if (parse_tokens_line(line, token, id)) {
+        token2id[token] = id;
+      }
+    }
+  }
+
+  // word -> index into words/ids of the last lexicon line of the word
+  StringMap<uint32_t> index;
+  std::vector<std::string> words;
+  std::vector<std::vector<int32_t>> ids;
+  size_t skipped = 0;
+  for (auto &fin : lexicons) {
+    std::ifstream input(fin);
+    if (!input) {
+      throw std::runtime_error("fail to open " + fin);
+    }
+    std::string line;
+    std::string_view word;
+    std::vector<std::string_view> tokens;
+    while (std::getline(input, line)) {
+      if (!parse_lexicon_line(line, word, tokens)) {
+        continue;
+      }
+      std::vector<int32_t> word_ids;
+      for (std::string_view token : tokens) {
+        const int32_t *id = token2id.find(token);
+        if (id == nullptr) {
+          ++skipped;
+          continue;
+        }
+        word_ids.push_back(*id);
+      }
+      if (word.size() > UINT16_MAX || word_ids.size() > UINT16_MAX) {
+        continue;
+      }
+      uint32_t &i = index[word];
+      if (i == 0) {
+        words.emplace_back(word);
+        ids.emplace_back();
+        i = words.size(); // 1 based, 0 is new
+      }
+      ids[i - 1] = std::move(word_ids);
+    }
+  }
+
+  Header header;
+  memcpy(header.magic, "KLEX", 4);
+  header.version = kVersion;
+  header.tokens_checksum = tokensChecksum(tokens_file);
+  header.num_words = words.size();
+  header.num_slots = 16;
+  while (header.num_slots < 2 * words.size()) {
+    header.num_slots *= 2;
+  }
+
+  std::vector<Slot> slots(header.num_slots, Slot{0, 0, kEmpty, 0, 0});
+  std::string keys;
+  std::vector<int32_t> all_ids;
+  size_t mask = header.num_slots - 1;
+  for (size_t w = 0; w < words.size(); ++w) {
+    uint64_t hash = hash_string(words[w]);
+    size_t i = hash & mask;
+    while (slots[i].ids_offset != kEmpty) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = Slot{(uint32_t)hash, (uint32_t)keys.size(), (uint32_t)all_ids.size(),
+                    (uint16_t)words[w].size(), (uint16_t)ids[w].size()};
+    keys += words[w];
+    all_ids.insert(all_ids.end(), ids[w].begin(), ids[w].end());
+  }
+  // keep the ids 4 byte aligned in the mapping
+  keys.resize((keys.size() + 3) / 4 * 4, '\0');
+  header.keys_size = keys.size();
+  header.num_ids = all_ids.size();
+
+  std::ofstream output(out_file, std::ios::binary);
+  output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  output.write(reinterpret_cast<const char *>(slots.data()), slots.size() * sizeof(Slot));
+  output.write(keys.data(), keys.size());
+  output.write(reinterpret_cast<const char *>(all_ids.data()), all_ids.size() * sizeof(int32_t));
+  if (!output) {
+    throw std::runtime_error("fail to write " + out_file);
+  }
+  std::cout << out_file << ": " << words.size() << " words, " << all_ids.size()
+            << " token ids, " << skipped << " unknown tokens skipped" << std::endl;
+}
@@ -0,0 +1,81 @@
+/*************************************************************************
+    > File Name: binary_lexicon.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月04日 星期五 14时02分51秒
+ ************************************************************************/
+#pragma once
+#include "mapped_file.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The lexicons compiled into one file, word -> token ids, that is used
+// straight from a read-only mmap: loading it is an open + mmap, the pages
+// are shared by all processes, and a word costs one hash lookup and gives
+// its ids ready to copy. Build it with tools/compile_lexicon from the text
+// lexicons and tokens.txt; the ids are only valid for that tokens.txt, so
+// the file records a checksum of it.
+//
+// Layout, little endian:
+//   Header
+//   Slot[num_slots]          open addressing index, num_slots a power of two
+//   char keys[keys_size]     the words, not terminated
+//   int32_t ids[num_ids]     the token ids of the words, back to back
+// The line formats of the text files, shared by TtsModel and
+// BinaryLexicon::compile so that both give the same ids. A trailing '\r'
+// (CRLF files) is dropped.
+// "word token token ...", the fields separated by spaces or tabs.
+// false for a blank line; the views point into line
+bool parse_lexicon_line(std::string_view line, std::string_view &word,
+                        std::vector<std::string_view> &tokens);
+// "token id", the space token is "  id". false for a line without an id
+bool parse_tokens_line(std::string_view line, std::string_view &token, int32_t &id);
+
+class BinaryLexicon {
+public:
+  struct Header {
+    char magic[4];            // "KLEX"
+    uint32_t version;
+    uint64_t tokens_checksum; // tokensChecksum() of the tokens.txt used
+    uint32_t num_words;
+    uint32_t num_slots;
+    uint32_t keys_size;
+    uint32_t num_ids;
+  };
+  struct Slot {
+    uint32_t hash;       // low bits of hash_string(word)
+    uint32_t key_offset;
+    uint32_t ids_offset; // kEmpty for a free slot
+    uint16_t key_size;
+    uint16_t num_ids;
+  };
+  // bump it on any change of the layout or of hash_string
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kEmpty = UINT32_MAX;
+
+  // throw std::runtime_error if the file is missing, truncated, of another
+  // version or compiled for another tokens.txt
+  BinaryLexicon(const std::string &path, const std::string &tokens_file);
+
+  // false if the word is not in the lexicon
+  bool find(std::string_view word, const int32_t *&ids, size_t &num_ids) const;
+  size_t size() const { return _header->num_words; }
+
+  // Compiles the text lexicons ("word token token ...") against tokens.txt.
+  // Tokens missing from tokens.txt are left out, like tokenize does.
+  // A word of several lexicons gets the entry of the last one.
+  // throw std::runtime_error if out_file cannot be written
+  static void compile(const std::vector<std::string> &lexicons,
+                      const std::string &tokens_file, const std::string &out_file);
+  static uint64_t tokensChecksum(const std::string &tokens_file);
+
+private:
+  MappedFile _file;
+  const Header *_header;
+  const Slot *_slots;
+  const char *_keys;
+  const int32_t *_ids;
+};
@@ -0,0 +1,77 @@
+/*************************************************************************
+    > File Name: bounded_queue.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月23日 星期一 10时16分05秒
+ ************************************************************************/
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Blocking FIFO with a fixed capacity, to connect the stages of a pipeline.
+// A full queue blocks the producer, which is the backpressure between stages.
+// After close(), push fails and pop drains what is left, then fails.
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : _capacity(capacity ? capacity : 1) {}
+
+  // blocks while the queue is full, false if the queue is closed
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_full.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+    if (_closed) {
+      return false;
+    }
+    _items.push_back(std::move(item));
+    _not_empty.notify_one();
+    return true;
+  }
+
+  // never blocks, false if the queue is full or closed
+  bool tryPush(T &item) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed || _items.size() >= _capacity) {
+      return false;
+    }
+    _items.push_back(std::move(item));
+    _not_empty.notify_one();
+    return true;
+  }
+
+  // blocks while the queue is empty, false once it is closed and drained
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_empty.wait(lock, [this] { return _closed || !_items.empty(); });
+    if (_items.empty()) {
+      return false;
+    }
+    item = std::move(_items.front());
+    _items.pop_front();
+    _not_full.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _not_full.notify_all();
+    _not_empty.notify_all();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _items.size();
+  }
+  size_t capacity() const { return _capacity; }
+
+private:
+  const size_t _capacity;
+  mutable std::mutex _mutex;
+  std::condition_variable _not_full;
+  std::condition_variable _not_empty;
+  std::deque<T> _items;
+  bool _closed = false;
+};
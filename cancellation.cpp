@@ -0,0 +1,153 @@
+/*************************************************************************
+    > File Name: cancellation.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月25日 星期三 14时08分47秒
+ ************************************************************************/
+#include "cancellation.h"
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <thread>
+
+namespace {
+
+// One thread for the whole process, it sleeps until the nearest deadline of
+// the Runs in flight and cancels the token then.
+class DeadlineWatchdog {
+public:
+  static DeadlineWatchdog &instance() {
+    static DeadlineWatchdog watchdog;
+    return watchdog;
+  }
+
+  void add(CancellationToken *token) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _deadlines.emplace(token->deadline(), token);
+    }
+    _cond.notify_one();
+  }
+
+  // after remove() returns the watchdog no longer touches token
+  void remove(CancellationToken *token) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto range = _deadlines.equal_range(token->deadline());
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == token) {
+        _deadlines.erase(it);
+        break;
+      }
+    }
+  }
+
+private:
+  DeadlineWatchdog() : _thread(&DeadlineWatchdog::loop, this) {}
+  ~DeadlineWatchdog() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+  }
+
+  void loop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stop) {
+      if (_deadlines.empty()) {
+        _cond.wait(lock);
+        continue;
+      }
+      auto first = _deadlines.begin();
+      if (CancellationToken::Clock::now() < first->first) {
+        _cond.wait_until(lock, first->first);
+        continue;
+      }
+      // under the lock, remove() waits until the token is cancelled
+      first->second->cancel();
+      _deadlines.erase(first);
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::multimap<CancellationToken::Clock::time_point, CancellationToken *> _deadlines;
+  bool _stop = false;
+  std::thread _thread;
+};
+
+} // namespace
+
+CancellationToken::CancellationToken(Clock::time_point deadline)
+    : _has_deadline(true), _deadline(deadline) {}
+
+CancellationToken CancellationToken::WithTimeout(std::chrono::milliseconds timeout) {
+  return CancellationToken(Clock::now() + timeout);
+}
+
+void CancellationToken::cancel() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _cancelled = true;
+  for (auto options : _runs) {
+    options->SetTerminate();
+  }
+}
+
+bool CancellationToken::cancelled() const {
+  return _cancelled || (_has_deadline && Clock::now() >= _deadline);
+}
+
+void CancellationToken::check() const {
+  if (cancelled()) {
+    throw TtsCancelled();
+  }
+}
+
+CancellationScope::CancellationScope(CancellationToken *token,
+                                     Ort::RunOptions &options)
+    : _token(token), _options(options) {
+  if (_token == nullptr) {
+    return;
+  }
+  _token->check();
+  // the watchdog first, if add() throws nothing is registered yet
+  if (_token->hasDeadline()) {
+    DeadlineWatchdog::instance().add(_token);
+    _watched = true;
+  }
+  bool cancelled = true;
+  try {
+    // cancel() sets the flag and terminates _runs under the same lock, so a
+    // cancel() racing with this either finds the Run in _runs or is seen here
+    std::lock_guard<std::mutex> lock(_token->_mutex);
+    cancelled = _token->cancelled();
+    if (!cancelled) {
+      _token->_runs.push_back(&_options);
+    }
+  } catch (...) {
+    // not under the token lock: the watchdog cancels under its own lock
+    if (_watched) {
+      DeadlineWatchdog::instance().remove(_token);
+    }
+    throw;
+  }
+  if (cancelled) {
+    if (_watched) {
+      DeadlineWatchdog::instance().remove(_token);
+    }
+    throw TtsCancelled();
+  }
+}
+
+CancellationScope::~CancellationScope() {
+  if (_token == nullptr) {
+    return;
+  }
+  if (_watched) {
+    DeadlineWatchdog::instance().remove(_token);
+  }
+  std::lock_guard<std::mutex> lock(_token->_mutex);
+  auto &runs = _token->_runs;
+  runs.erase(std::find(runs.begin(), runs.end(), &_options));
+}
@@ -0,0 +1,71 @@
+/*************************************************************************
+    > File Name: cancellation.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月25日 星期三 14时08分19秒
+ ************************************************************************/
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <onnxruntime_cxx_api.h>
+#include <stdexcept>
+#include <vector>
+
+// thrown by the synthesis calls when their CancellationToken was cancelled
+// or its deadline passed
+class TtsCancelled : public std::runtime_error {
+public:
+  TtsCancelled() : std::runtime_error("tts request cancelled") {}
+};
+
+// Per request cancellation flag and optional deadline.
+// The synthesis checks it between its stages, and while a session Run is in
+// flight, cancel() (or the deadline, see CancellationScope) calls
+// RunOptions::SetTerminate so ORT stops the Run early. The token must outlive
+// the calls it is passed to. cancel() may be called from any thread.
+class CancellationToken {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  CancellationToken() = default;
+  explicit CancellationToken(Clock::time_point deadline);
+  static CancellationToken WithTimeout(std::chrono::milliseconds timeout);
+  CancellationToken(const CancellationToken &) = delete;
+  CancellationToken &operator=(const CancellationToken &) = delete;
+
+  void cancel();
+  // cancel() was called or the deadline passed
+  bool cancelled() const;
+  // throw TtsCancelled if cancelled()
+  void check() const;
+
+  bool hasDeadline() const { return _has_deadline; }
+  Clock::time_point deadline() const { return _deadline; }
+
+private:
+  friend class CancellationScope;
+  std::atomic<bool> _cancelled{false};
+  bool _has_deadline = false;
+  Clock::time_point _deadline;
+
+  std::mutex _mutex;
+  std::vector<Ort::RunOptions *> _runs; // Runs in flight
+};
+
+// Ties one session Run to a token for the lifetime of the scope: cancel(),
+// or a watchdog thread once the deadline passes, terminates options.
+// Throws TtsCancelled right away if the token is already cancelled.
+// A nullptr token does nothing.
+class CancellationScope {
+public:
+  CancellationScope(CancellationToken *token, Ort::RunOptions &options);
+  ~CancellationScope();
+  CancellationScope(const CancellationScope &) = delete;
+  CancellationScope &operator=(const CancellationScope &) = delete;
+
+private:
+  CancellationToken *_token;
+  Ort::RunOptions &_options;
+  bool _watched = false;
+};
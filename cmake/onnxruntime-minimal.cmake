@@ -0,0 +1,18 @@
+# Reduced operator onnxruntime, see tools/build_minimal_ort.sh
+if(NOT EXISTS ${KOKORO_ORT_MINIMAL_DIR}/include/onnxruntime_cxx_api.h)
+  message(FATAL_ERROR "No minimal onnxruntime in ${KOKORO_ORT_MINIMAL_DIR}, run tools/build_minimal_ort.sh first")
+endif()
+
+set(onnxruntime_SOURCE_DIR ${KOKORO_ORT_MINIMAL_DIR})
+include_directories(${KOKORO_ORT_MINIMAL_DIR}/include)
+
+# tools/build_minimal_ort.sh builds onnxruntime as a shared library, the
+# operators and its deps are linked into libonnxruntime.so
+file(GLOB onnxruntime_lib_files "${KOKORO_ORT_MINIMAL_DIR}/lib/libonnxruntime.so*")
+if(NOT onnxruntime_lib_files)
+  message(FATAL_ERROR "No libonnxruntime.so in ${KOKORO_ORT_MINIMAL_DIR}/lib, run tools/build_minimal_ort.sh first")
+endif()
+install(FILES ${onnxruntime_lib_files} DESTINATION lib)
+message(STATUS "minimal onnxruntime lib files: ${onnxruntime_lib_files}")
+
+add_definitions(-DKOKORO_ORT_MINIMAL)
@@ -0,0 +1,72 @@
+/*************************************************************************
+    > File Name: cpu_affinity.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月30日 星期一 10时05分40秒
+ ************************************************************************/
+#include "cpu_affinity.h"
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+
+std::vector<int32_t> parse_cpu_list(const std::string &list) {
+  std::vector<int32_t> cpus;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty() || item == "\n") {
+      continue;
+    }
+    try {
+      size_t dash = item.find('-');
+      int32_t first = std::stoi(item.substr(0, dash));
+      int32_t last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+      if (first < 0 || last < first) {
+        throw std::invalid_argument(item);
+      }
+      for (int32_t cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::logic_error &) {
+      throw std::invalid_argument("bad cpu list: " + list);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int32_t> numa_node_cpus(int32_t node) {
+  std::ifstream input("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+  std::string line;
+  if (!input || !std::getline(input, line)) {
+    return {};
+  }
+  return parse_cpu_list(line);
+}
+
+bool pin_current_thread(const std::vector<int32_t> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    std::cout << "fail to set thread affinity, error " << ret << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::string ort_thread_affinity(const std::vector<int32_t> &cpus, int32_t num_threads) {
+  std::string affinity;
+  if (cpus.empty()) {
+    return affinity;
+  }
+  for (int32_t t = 1; t < num_threads; ++t) {
+    affinity += (t > 1 ? ";" : "") + std::to_string(cpus[t % cpus.size()] + 1);
+  }
+  return affinity;
+}
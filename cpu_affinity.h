@@ -0,0 +1,26 @@
+/*************************************************************************
+    > File Name: cpu_affinity.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月30日 星期一 10时05分12秒
+ ************************************************************************/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}, the format of
+// /sys/devices/system/node/node<N>/cpulist and of taskset -c
+// throw std::invalid_argument on a malformed list
+std::vector<int32_t> parse_cpu_list(const std::string &list);
+
+// cpus of a NUMA node, empty if the node does not exist
+std::vector<int32_t> numa_node_cpus(int32_t node);
+
+// restrict the calling thread to cpus, false (and a message) on failure
+bool pin_current_thread(const std::vector<int32_t> &cpus);
+
+// ORT affinity string of num_threads - 1 pool threads (ORT counts the calling
+// thread as the first one), one cpu each, taken in turn from cpus[1..] so the
+// calling thread keeps cpus[0]. ORT numbers the processors from 1.
+std::string ort_thread_affinity(const std::vector<int32_t> &cpus, int32_t num_threads);
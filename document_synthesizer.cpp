@@ -0,0 +1,121 @@
+/*************************************************************************
+    > File Name: document_synthesizer.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月20日 星期五 14时38分20秒
+ ************************************************************************/
+#include "document_synthesizer.h"
+#include <atomic>
+#include <exception>
+#include <thread>
+
+DocumentSynthesizer::DocumentSynthesizer(std::shared_ptr<const TtsModel> model,
+                                         int32_t parallelism)
+    : _model(std::move(model)) {
+  if (parallelism <= 0) {
+    parallelism = _model->_sessions->size();
+  }
+  for (int32_t i = 0; i < parallelism; ++i) {
+    _contexts.push_back(std::make_unique<TtsContext>(_model));
+  }
+  try {
+    for (size_t w = 1; w < _contexts.size(); ++w) {
+      _threads.emplace_back(&DocumentSynthesizer::workerLoop, this, w);
+    }
+  } catch (...) {
+    stopWorkers();
+    throw;
+  }
+}
+
+DocumentSynthesizer::~DocumentSynthesizer() { stopWorkers(); }
+
+void DocumentSynthesizer::stopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _start.notify_all();
+  for (auto &t : _threads) {
+    t.join();
+  }
+  _threads.clear();
+}
+
+void DocumentSynthesizer::workerLoop(size_t w) {
+  _model->_config.pinWorkerThread();
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _start.wait(lock, [&] { return _stop || _generation != seen; });
+    if (_stop) {
+      return;
+    }
+    seen = _generation;
+    const std::function<void(TtsContext &)> &job = *_job;
+    lock.unlock();
+    job(*_contexts[w]); // does not throw, the errors are kept by the job
+    lock.lock();
+    if (--_busy == 0) {
+      _done.notify_one();
+    }
+  }
+}
+
+void DocumentSynthesizer::run(const std::vector<std::string> &chunks,
+                              const std::string &voice,
+                              std::vector<float> &out_audio,
+                              CancellationToken *cancel) {
+  std::lock_guard<std::mutex> run_lock(_run_mutex);
+  _model->voice(voice); // fail before waking the workers
+
+  std::vector<std::vector<float>> audio(chunks.size());
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  std::function<void(TtsContext &)> worker = [&](TtsContext &context) {
+    size_t i;
+    while ((i = next++) < chunks.size()) {
+      try {
+        context.run(chunks[i], voice, audio[i], cancel);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = chunks.size(); // stop handing out chunks
+      }
+    }
+  };
+
+  // with fewer chunks than workers the spare ones find nothing to do
+  bool wake = chunks.size() > 1 && !_threads.empty();
+  if (wake) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _job = &worker;
+      _busy = _threads.size();
+      ++_generation;
+    }
+    _start.notify_all();
+  }
+  worker(*_contexts[0]); // the calling thread is a worker too
+  if (wake) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [&] { return _busy == 0; });
+    _job = nullptr;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  size_t total = out_audio.size();
+  for (auto &a : audio) {
+    total += a.size();
+  }
+  out_audio.reserve(total);
+  for (auto &a : audio) {
+    out_audio.insert(out_audio.end(), a.begin(), a.end());
+  }
+}
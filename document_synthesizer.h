@@ -0,0 +1,63 @@
+/*************************************************************************
+    > File Name: document_synthesizer.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月20日 星期五 14时37分52秒
+ ************************************************************************/
+#pragma once
+#include "kokoro.h"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Synthesizes the chunks of a long document (e.g. the merged sentences of
+// main.cc) on several contexts at once. Chunks are handed out in order, their
+// audio is collected as they finish and concatenated in chunk order.
+// The speedup is bounded by the number of sessions of the model pool
+// (TtsConfig::num_sessions) and by the cores each session gets.
+// The worker threads are started once by the constructor and reused by every
+// run(). run() may be called from several threads, the calls take turns:
+// each one uses all the workers.
+class DocumentSynthesizer {
+public:
+  // parallelism <= 0: one worker per session of the model pool
+  explicit DocumentSynthesizer(std::shared_ptr<const TtsModel> model,
+                               int32_t parallelism = 0);
+  ~DocumentSynthesizer();
+
+  DocumentSynthesizer(const DocumentSynthesizer &) = delete;
+  DocumentSynthesizer &operator=(const DocumentSynthesizer &) = delete;
+
+  // chunks are normalized text, each at most _max_len tokens long;
+  // the audio is appended to out_audio. A cancelled token stops all the
+  // workers, run() throws TtsCancelled then.
+  void run(const std::vector<std::string> &chunks, const std::string &voice,
+           std::vector<float> &out_audio, CancellationToken *cancel = nullptr);
+
+  int32_t parallelism() const { return _contexts.size(); }
+
+private:
+  void workerLoop(size_t w);
+  void stopWorkers();
+
+  std::shared_ptr<const TtsModel> _model;
+  std::vector<std::unique_ptr<TtsContext>> _contexts;
+
+  std::mutex _run_mutex; // one run() at a time
+
+  // _contexts[0] is used by the thread calling run(), _contexts[w] by
+  // _threads[w - 1]. A run bumps _generation to wake the threads on _job
+  // and waits on _done for _busy to drop to 0.
+  std::mutex _mutex;
+  std::condition_variable _start;
+  std::condition_variable _done;
+  const std::function<void(TtsContext &)> *_job = nullptr;
+  uint64_t _generation = 0;
+  size_t _busy = 0;
+  bool _stop = false;
+  std::vector<std::thread> _threads;
+};
@@ -0,0 +1,87 @@
+/*************************************************************************
+    > File Name: g2p_cache.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月08日 星期二 15时27分02秒
+ ************************************************************************/
+#include "g2p_cache.h"
+#include <sstream>
+
+std::string G2pCache::Stats::toString() const {
+  std::ostringstream os;
+  uint64_t lookups = hits + misses;
+  os << "g2p cache: " << entries << " entries, " << bytes << " bytes, hits "
+     << hits << "/" << lookups;
+  if (lookups > 0) {
+    os << " (" << 100.0 * hits / lookups << "%)";
+  }
+  os << ", evictions " << evictions;
+  return os.str();
+}
+
+G2pCache::G2pCache(size_t max_bytes) : _max_bytes(max_bytes) {}
+
+size_t G2pCache::entryBytes(const Entry &entry) {
+  // the list node, the index node and its bucket, roughly
+  static constexpr size_t kOverhead = sizeof(Entry) + 2 * sizeof(void *) + 48;
+  return kOverhead + entry.segment.capacity() + entry.ids.capacity() * sizeof(int32_t);
+}
+
+bool G2pCache::lookup(std::string_view segment, std::vector<int64_t> &token_ids) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _index.find(segment);
+  if (it == _index.end()) {
+    ++_misses;
+    return false;
+  }
+  ++_hits;
+  _lru.splice(_lru.begin(), _lru, it->second);
+  const std::vector<int32_t> &ids = it->second->ids;
+  token_ids.insert(token_ids.end(), ids.begin(), ids.end());
+  return true;
+}
+
+void G2pCache::insert(std::string_view segment, const int64_t *token_ids, size_t num_ids) {
+  // built outside the lock
+  Entry entry{std::string(segment), std::vector<int32_t>(token_ids, token_ids + num_ids)};
+  size_t bytes = entryBytes(entry);
+  if (bytes > _max_bytes) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _index.find(segment);
+  if (it != _index.end()) {
+    // another context missed on it at the same time
+    _lru.splice(_lru.begin(), _lru, it->second);
+    return;
+  }
+  while (!_lru.empty() && _bytes + bytes > _max_bytes) {
+    Entry &last = _lru.back();
+    _bytes -= entryBytes(last);
+    _index.erase(last.segment);
+    _lru.pop_back();
+    ++_evictions;
+  }
+  _lru.push_front(std::move(entry));
+  _index.emplace(_lru.front().segment, _lru.begin());
+  _bytes += bytes;
+}
+
+void G2pCache::clear() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _index.clear();
+  _lru.clear();
+  _bytes = 0;
+}
+
+G2pCache::Stats G2pCache::stats() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Stats stats;
+  stats.hits = _hits;
+  stats.misses = _misses;
+  stats.evictions = _evictions;
+  stats.entries = _lru.size();
+  stats.bytes = _bytes;
+  return stats;
+}
@@ -0,0 +1,64 @@
+/*************************************************************************
+    > File Name: g2p_cache.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月08日 星期二 15时26分40秒
+ ************************************************************************/
+#pragma once
+#include "string_map.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// LRU cache of front end results, hanzi segment -> token ids, so that the
+// phrases a service says again and again (greetings, menus, product names)
+// skip jieba and the lexicon lookups. Bounded by max_bytes, counting the
+// keys, the ids and the bookkeeping of every entry. Shared by all the
+// contexts of a model, every call takes a mutex.
+class G2pCache {
+public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    std::string toString() const;
+  };
+
+  explicit G2pCache(size_t max_bytes);
+  G2pCache(const G2pCache &) = delete;
+  G2pCache &operator=(const G2pCache &) = delete;
+
+  // appends the ids of segment to token_ids, false (a miss) if it is not cached
+  bool lookup(std::string_view segment, std::vector<int64_t> &token_ids);
+  // evicts the least recently used entries to make room, an entry larger
+  // than the whole cache is not stored
+  void insert(std::string_view segment, const int64_t *token_ids, size_t num_ids);
+  void clear();
+  Stats stats() const;
+
+private:
+  struct Entry {
+    std::string segment;
+    std::vector<int32_t> ids;
+  };
+  using List = std::list<Entry>;
+  struct Hash {
+    size_t operator()(std::string_view s) const { return hash_string(s); }
+  };
+  static size_t entryBytes(const Entry &entry);
+
+  const size_t _max_bytes;
+  mutable std::mutex _mutex;
+  List _lru; // most recently used first
+  std::unordered_map<std::string_view, List::iterator, Hash> _index; // keys view Entry::segment
+  size_t _bytes = 0;
+  uint64_t _hits = 0;
+  uint64_t _misses = 0;
+  uint64_t _evictions = 0;
+};
@@ -6,8 +6,13 @@
  ************************************************************************/
 #include "kokoro.h"
 #include "onnxruntime_cxx_api.h"
+#include "tts_executor.h"
 #include "util.h"
+#include "utf8.h"
 #include "algorithm"
+#include <cstdio>
+#include <filesystem>
+#include <unistd.h>
 
 /*--------------------util------------------*/
 std::vector<std::string> split_string(const std::string &s, char delimiter) {
@@ -33,39 +38,204 @@ std::vector<float>  load_vec(const std::string& fin) {
     }
     return ret;
 }
-std::vector<std::string> utf8_to_charset(const std::string &input) {
-    std::vector<std::string> output;
-    std::string ch;
-    for (size_t i = 0, len = 0; i != input.length(); i += len) {
-      unsigned char byte = (unsigned)input[i];
-      if (byte >= 0xFC) // lenght 6
-        len = 6;
-      else if (byte >= 0xF8)
-        len = 5;
-      else if (byte >= 0xF0)
-        len = 4;
-      else if (byte >= 0xE0)
-        len = 3;
-      else if (byte >= 0xC0)
-        len = 2;
-      else
-        len = 1;
-      ch = input.substr(i, len);
-      output.push_back(ch);
-    }
-    return output;
+
+// 64 bit hash of the file content, used to key the optimized model cache
+uint64_t hash_file(const std::string &path) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    throw std::runtime_error("fail to open " + path);
+  }
+  uint64_t hash = 1469598103934665603ULL; // FNV-1a offset basis
+  std::vector<char> buffer(1 << 20);
+  while (input) {
+    input.read(buffer.data(), buffer.size());
+    size_t n = input.gcount();
+    // mix 8 bytes at a time, the byte-wise FNV loop is too slow for a 300MB model
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      uint64_t word;
+      memcpy(&word, buffer.data() + i, 8);
+      hash = (hash ^ word) * 1099511628211ULL;
+      hash ^= hash >> 29;
+    }
+    for (; i < n; ++i) {
+      hash = (hash ^ (unsigned char)buffer[i]) * 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+// Returns the model file the session should be created from.
+// If the optimized graph of kokoro_onnx is already cached it is returned and
+// graph optimization is turned off, else the options are set up to write the
+// optimized graph into the cache while the session is built.
+// The cache file is keyed on the model, the ORT version and the session
+// options that change the optimized graph (TtsConfig::graphOptions).
+std::string prepare_optimized_model(const std::string &kokoro_onnx,
+                                    const TtsConfig &config,
+                                    Ort::SessionOptions &options,
+                                    std::string &cache_file,
+                                    std::string &tmp_file) {
+  namespace fs = std::filesystem;
+  char key[64];
+  snprintf(key, sizeof(key), "%016llx-O%d-%08x",
+           (unsigned long long)hash_file(kokoro_onnx), (int)config.graph_optimization_level,
+           (unsigned)hash_string(config.graphOptions()));
+  cache_file = config.optimized_model_dir + "/" + fs::path(kokoro_onnx).stem().string() +
+               "-" + key + "-ort" + Ort::GetVersionString() + ".onnx";
+  if (fs::exists(cache_file)) {
+    std::cout << "load optimized model: " << cache_file << std::endl;
+    options.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+    std::string optimized = cache_file;
+    cache_file.clear();
+    return optimized;
+  }
+  std::error_code ec;
+  fs::create_directories(config.optimized_model_dir, ec);
+  // write to a temporary name first, other processes may start at the same time
+  tmp_file = cache_file + "." + std::to_string(getpid()) + ".tmp";
+  options.SetOptimizedModelFilePath(tmp_file.c_str());
+  return kokoro_onnx;
+}
+
+// names and shapes of the inputs and outputs of session, the names are
+// owned by names
+static void read_io(Ort::Session &session, std::vector<const char *> &input_names,
+                    std::vector<std::vector<int64_t>> &input_dims,
+                    std::vector<const char *> &output_names,
+                    std::vector<std::unique_ptr<char[]>> &names) {
+  Ort::AllocatorWithDefaultOptions allocator;
+
+  // 获取输入信息
+  size_t num_input_nodes = session.GetInputCount();
+  input_names.reserve(num_input_nodes);
+
+  for (size_t i = 0; i < num_input_nodes; i++) {
+    auto input_name = session.GetInputNameAllocated(i, allocator);
+
+    names.emplace_back(new char[strlen(input_name.get()) + 1]); // +1 用于空终止符
+    char *dest = names.back().get();
+    input_names.push_back(dest);
+    strcpy(dest, input_name.get());
+
+    Ort::TypeInfo type_info = session.GetInputTypeInfo(i);
+    auto tensor_info = type_info.GetTensorTypeAndShapeInfo();
+
+    std::vector<int64_t> dims = tensor_info.GetShape();
+    std::cout << "Input " << i << " name: " << dest << std::endl;
+    std::cout << "Input shape: ";
+    for (auto dim : dims) {
+      std::cout << dim << " ";
+    }
+    input_dims.push_back(dims);
+    std::cout << std::endl;
+  }
+
+  // 获取输出信息
+  size_t num_output_nodes = session.GetOutputCount();
+  output_names.reserve(num_output_nodes);
+
+  for (size_t i = 0; i < num_output_nodes; i++) {
+    auto output_name = session.GetOutputNameAllocated(i, allocator);
+    names.emplace_back(new char[strlen(output_name.get()) + 1]);
+    char *dest = names.back().get();
+    strcpy(dest, output_name.get());
+    output_names.push_back(dest);
+
+    Ort::TypeInfo type_info = session.GetOutputTypeInfo(i);
+    auto tensor_info = type_info.GetTensorTypeAndShapeInfo();
+
+    std::vector<int64_t> output_dims = tensor_info.GetShape();
+    std::cout << "Output " << i << " name: " << dest << std::endl;
+    std::cout << "Output shape: ";
+    for (auto dim : output_dims) {
+      std::cout << dim << " ";
+    }
+    std::cout << std::endl;
   }
+}
+
+// model files converted with onnxruntime.tools.convert_onnx_models_to_ort
+static bool is_ort_format(const std::string &path) {
+  return std::filesystem::path(path).extension() == ".ort";
+}
+
+// Sets up options for an ORT format model. It is parsed with flatbuffers
+// instead of protobuf and holds the already optimized graph. When the model
+// bytes stay valid for the life of the session (the use_mmap case), ORT uses
+// them in place, initializers included, instead of copying them.
+static void use_ort_format(const std::string &path, Ort::SessionOptions &options,
+                           bool bytes_stay_valid) {
+#ifdef KOKORO_ORT_MINIMAL
+  if (!is_ort_format(path)) {
+    throw std::invalid_argument("minimal onnxruntime build, only ORT format (.ort) "
+                                "models can be loaded: " + path);
+  }
+#endif
+  if (!is_ort_format(path)) {
+    return;
+  }
+  options.AddConfigEntry("session.load_model_format", "ORT");
+  if (bytes_stay_valid) {
+    options.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+    options.AddConfigEntry("session.use_ort_model_bytes_for_initializers", "1");
+  }
+}
+
 /* ----------------------------------------- */
 
-Tts::Tts(const std::string &kokoro_onnx, const std::string &tokens,
-         const std::vector<std::string> &lexicons,
-         const std::string &voices_bin, const std::string &jieba_dir) {
-  env_ = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "kokoro");
-  session_options_.SetInterOpNumThreads(1);
-  session_ = std::make_unique<Ort::Session>(env_, kokoro_onnx.c_str(),
-                                            session_options_);
+TtsModel::TtsModel(const std::string &kokoro_onnx, const std::string &tokens,
+                   const std::vector<std::string> &lexicons,
+                   const std::string &voices_bin, const std::string &jieba_dir,
+                   const TtsConfig &config)
+    : _config(config) {
+  _sessions = std::make_unique<SessionPool>(_config);
+  _config.apply(session_options_, _sessions->globalThreadPools());
+  use_ort_format(kokoro_onnx, session_options_, _config.use_mmap);
+  std::cout << "session config: " << _config.toString() << std::endl;
+  std::string model_path = kokoro_onnx;
+  std::string cache_file, tmp_file;
+  // only the first session may write the optimized model
+  Ort::SessionOptions first_options = session_options_.Clone();
+  // an ORT format model is optimized already
+  if (!_config.optimized_model_dir.empty() && !is_ort_format(kokoro_onnx)) {
+    model_path = prepare_optimized_model(kokoro_onnx, _config, first_options,
+                                         cache_file, tmp_file);
+  }
+  try {
+    addSession(*_sessions, model_path, first_options);
+  } catch (...) {
+    // ORT may have written part of the optimized model
+    if (!tmp_file.empty()) {
+      std::error_code ec;
+      std::filesystem::remove(tmp_file, ec);
+    }
+    throw;
+  }
+  if (!tmp_file.empty()) {
+    std::error_code ec;
+    std::filesystem::rename(tmp_file, cache_file, ec);
+    if (ec) {
+      std::cout << "fail to save optimized model " << cache_file << ": "
+                << ec.message() << std::endl;
+      std::filesystem::remove(tmp_file, ec);
+    } else {
+      std::cout << "save optimized model: " << cache_file << std::endl;
+      model_path = cache_file;
+    }
+  }
+  // the other sessions load the optimized graph, if there is one
+  if (model_path != kokoro_onnx) {
+    session_options_.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+  }
+  for (int32_t i = 1; i < _config.num_sessions; ++i) {
+    addSession(*_sessions, model_path, session_options_);
+  }
   load_tokens(tokens);
-  load_lexicons(lexicons);
+  load_lexicons(lexicons, tokens);
+  if (_config.g2p_cache_bytes > 0) {
+    _g2p_cache = std::make_unique<G2pCache>(_config.g2p_cache_bytes);
+  }
 
   std::map<std::string, std::string> meta;
   getCustomMetadataMap(meta);
@@ -79,6 +249,13 @@ Tts::Tts(const std::string &kokoro_onnx, const std::string &tokens,
   load_voices(speaker_names, _style_dims, voices_bin);
   _sample_rate = 24000;
   _max_len = _style_dims[0] - 1;
+  // kokoro predicts durations in frames of 600 samples (24kHz / 40Hz)
+  _samples_per_frame = meta.count("samples_per_frame") ? stoi(meta["samples_per_frame"]) : 600;
+  // Speech runs at about 3 frames per token, the pauses of the punctuation
+  // take longer, 12 frames (0.3s) on average over an utterance at speed 1.0
+  // leaves a wide margin. 509 tokens then need ~3.7M samples instead of the
+  // ~9.8M of a bound per single token.
+  _max_frames_per_token = meta.count("max_frames_per_token") ? stoi(meta["max_frames_per_token"]) : 12;
   // Please download dict files form
   // https://github.com/csukuangfj/cppjieba/releases/download/sherpa-onnx-2024-04-19/dict.tar.bz2
   std::string kDictPath = jieba_dir + "/jieba.dict.utf8";
@@ -91,28 +268,157 @@ Tts::Tts(const std::string &kokoro_onnx, const std::string &tokens,
       kIdfPath.c_str(), kStopWordPath.c_str());
 
   setupIO();
+  // A batch export takes [B, T] tokens, [B, 256] styles and [B] speeds and
+  // also outputs the per token durations, needed to cut the padded audio.
+  for (size_t i = 0; i < output_names_.size(); ++i) {
+    if (std::string(output_names_[i]) == "durations") {
+      _durations_output = i;
+    }
+  }
+  _max_batch_size = meta.count("max_batch_size") ? stoi(meta["max_batch_size"]) : 1;
+  _batch_capable = _max_batch_size > 1 && _durations_output >= 0;
+  // paddedLength takes the first bucket that fits
+  auto &buckets = _config.bucket_lengths;
+  for (auto len : buckets) {
+    if (len <= 0) {
+      throw std::invalid_argument("bucket_lengths must be positive");
+    }
+  }
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+  _bucketing = !buckets.empty();
+  if (_bucketing && _durations_output < 0) {
+    std::cout << "kokoro model has no durations output, padding to bucket_lengths is disabled" << std::endl;
+    _bucketing = false;
+  }
+  if (!_config.decoder_model.empty()) {
+    setupDecoder();
+  }
   std::string punctuations = R"( ;:,.!?-…()\"“”)";
   for (auto p : punctuations) {
       _punc_set.insert(p);
+      if ((unsigned char)p < 0x80) {
+          _ascii_punc[(unsigned char)p] = true;
+      }
+  }
+  for (char p : std::string(".!?;:")) {
+    int64_t id = tokenId(std::string_view(&p, 1));
+    if (id >= 0) {
+      _sentence_end_ids.insert(id);
+    }
+  }
+  for (char p : std::string(",-")) {
+    int64_t id = tokenId(std::string_view(&p, 1));
+    if (id >= 0) {
+      _phrase_end_ids.insert(id);
+    }
+  }
+  _space_id = tokenId(" ");
+
+  if (_config.warmup_on_start) {
+    // the context only borrows the model under construction
+    TtsContext context(std::shared_ptr<const TtsModel>(std::shared_ptr<const TtsModel>(), this));
+    context.warmup();
+  }
+}
+
+void TtsModel::addSession(SessionPool &pool, const std::string &model_path,
+                          const Ort::SessionOptions &options) {
+  if (!_config.use_mmap) {
+    pool.addSession(model_path, options);
+    return;
+  }
+  // map every file once, the optimized model may replace the original one
+  // after the first session
+  if (_model_files.empty() || _model_files.back()->path() != model_path) {
+    _model_files.push_back(std::make_unique<MappedFile>(model_path));
+  }
+  const MappedFile &file = *_model_files.back();
+  pool.addSession(file.data(), file.size(), options);
+}
+
+void TtsModel::setupDecoder() {
+  if (_config.decoder_overlap_frames < 0 ||
+      _config.decoder_window_frames <= _config.decoder_overlap_frames) {
+    throw std::invalid_argument("decoder_window_frames must be larger than decoder_overlap_frames");
+  }
+  // the encoder options may have the graph optimization turned off for a
+  // cached model, the decoder starts from the config again
+  _decoder_sessions = std::make_unique<SessionPool>(_config);
+  Ort::SessionOptions options;
+  _config.apply(options, _decoder_sessions->globalThreadPools());
+  use_ort_format(_config.decoder_model, options, _config.use_mmap);
+  for (int32_t i = 0; i < std::max(1, _config.num_sessions); ++i) {
+    addSession(*_decoder_sessions, _config.decoder_model, options);
+  }
+  read_io(_decoder_sessions->session(0), decoder_input_names_,
+          decoder_input_dims_, decoder_output_names_, _io_names);
+
+  bool has_features = false;
+  for (auto name : decoder_input_names_) {
+    int32_t feed = -1;
+    if (std::string(name) != "style") {
+      for (size_t i = 0; i < output_names_.size(); ++i) {
+        if (strcmp(name, output_names_[i]) == 0) {
+          feed = i;
+        }
+      }
+      if (feed < 0) {
+        throw std::runtime_error(std::string("decoder input ") + name +
+                                 " is not an output of the encoder");
+      }
+      has_features = true;
+    }
+    _decoder_feeds.push_back(feed);
   }
+  if (!has_features) {
+    throw std::runtime_error("decoder has no input from the encoder");
+  }
+  _two_stage = true;
+  // batches and buckets cut the audio with the durations after a single run
+  if (_batch_capable || _bucketing) {
+    std::cout << "two-stage kokoro model, batching and bucket_lengths are disabled" << std::endl;
+  }
+  _batch_capable = false;
+  _bucketing = false;
 }
 
-int Tts::load_voices(const std::vector<std::string> &speaker_names,
-                     std::vector<int64_t> &dims,
-                     const std::string &voices_bin) {
+int TtsModel::load_voices(const std::vector<std::string> &speaker_names,
+                          std::vector<int64_t> &dims,
+                          const std::string &voices_bin) {
   int n_speaker = speaker_names.size();
   int max_len = _style_dims[0]; // 510
   int emb_dim = _style_dims[2]; // 256
 
-  std::ifstream file(voices_bin, std::ios::binary);
-  if (!file) {
-    std::cout << "fail to open " << voices_bin << std::endl;
-    return -1;
-  }
+  const float *float_data = nullptr;
+  size_t file_size = 0;
+  if (_config.use_mmap) {
+    try {
+      _voices_file = std::make_unique<MappedFile>(voices_bin);
+    } catch (const std::runtime_error &e) {
+      std::cout << e.what() << std::endl;
+      return -1;
+    }
+    file_size = _voices_file->size();
+    float_data = reinterpret_cast<const float *>(_voices_file->data());
+  } else {
+    std::ifstream file(voices_bin, std::ios::binary);
+    if (!file) {
+      std::cout << "fail to open " << voices_bin << std::endl;
+      return -1;
+    }
+
+    file.seekg(0, std::ios::end);
+    file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
 
-  file.seekg(0, std::ios::end);
-  size_t file_size = file.tellg();
-  file.seekg(0, std::ios::beg);
+    // read straight into the float buffer the voices point to
+    _voices_data.resize(file_size / sizeof(float));
+    file.read(reinterpret_cast<char *>(_voices_data.data()),
+              _voices_data.size() * sizeof(float));
+    file.close();
+    float_data = _voices_data.data();
+  }
 
   std::cout << voices_bin << " file_size:" << file_size <<std::endl;
   if (n_speaker * max_len * emb_dim * sizeof(float) != file_size) {
@@ -120,49 +426,63 @@ int Tts::load_voices(const std::vector<std::string> &speaker_names,
     return -2;
   }
 
-  // 2. 读取数据到 uint8 缓冲区
-  std::vector<uint8_t> buffer(file_size);
-  file.read(reinterpret_cast<char *>(buffer.data()), file_size);
-  file.close();
-
-  // // 3. 重新解释为 float32 数组
-  const float *float_data = reinterpret_cast<const float *>(buffer.data());
+  // every voice is a view, no per speaker copy
+  int chunk_size = max_len * emb_dim;
   for (int n = 0; n < n_speaker; ++n) {
-    int chunk_size = max_len * emb_dim;
-    _voices[speaker_names[n]].assign(float_data + n * chunk_size,
-                                     float_data + n * chunk_size + chunk_size);
+    _voices[speaker_names[n]] = float_data + n * chunk_size;
   }
   return 0;
 }
 
-void Tts::load_lexicons(const std::vector<std::string> &lexicon_files) {
+void TtsModel::load_lexicons(const std::vector<std::string> &lexicon_files,
+                             const std::string &token_file) {
+  if (lexicon_files.size() == 1 && lexicon_files[0].size() > 4 &&
+      lexicon_files[0].compare(lexicon_files[0].size() - 4, 4, ".bin") == 0) {
+    _binary_lexicon = std::make_unique<BinaryLexicon>(lexicon_files[0], token_file);
+    std::cout << "word2ids size: " << _binary_lexicon->size() << std::endl;
+    return;
+  }
+  size_t unknown = 0;
   for (auto &fin : lexicon_files) {
     std::ifstream input(fin);
 
     std::string line;
+    std::string_view word;
+    std::vector<std::string_view> tokens;
     while (std::getline(input, line)) {
-      auto arr = split_string(line, ' ');
-      std::vector<std::string> tokens (arr.begin() + 1, arr.end());
-      _word2token[arr[0]] = tokens;
+      // the same parser as BinaryLexicon::compile
+      if (!parse_lexicon_line(line, word, tokens)) {
+        continue;
+      }
+      // a word of several lexicons keeps the ids of the last one
+      LexiconEntry &entry = _word2ids[word];
+      entry.offset = _lexicon_ids.size();
+      for (std::string_view token : tokens) {
+        int64_t id = tokenId(token);
+        if (id < 0) {
+          ++unknown;
+          continue;
+        }
+        _lexicon_ids.push_back(id);
+      }
+      entry.size = _lexicon_ids.size() - entry.offset;
     }
   }
-  if (_word2token.size() > 0) {
-    std::cout << "token2id size: " << _word2token.size();
-  } else {
-    std::cout << "token2id size: " << _word2token.size();
+  std::cout << "word2ids size: " << _word2ids.size() << std::endl;
+  if (unknown > 0) {
+    std::cout << "skip " << unknown << " unknown lexicon tokens" << std::endl;
   }
 }
 
-void Tts::load_tokens(const std::string &token_file) {
+void TtsModel::load_tokens(const std::string &token_file) {
   std::ifstream input(token_file);
 
   std::string line;
+  std::string_view token;
+  int32_t id;
   while (std::getline(input, line)) {
-    auto arr = split_string(line, ' ');
-    if (arr.size() == 2) {
-      _token2id[arr[0]] = stoi(arr[1]);
-    } else {
-      _token2id[" "] = stoi(arr[2]);
+    if (parse_tokens_line(line, token, id)) {
+      _token2id[token] = id;
     }
   }
   if (_token2id.size() > 0) {
@@ -172,222 +492,715 @@ void Tts::load_tokens(const std::string &token_file) {
   }
 }
 
-std::vector<std::string> Tts::split_ch_eng(const std::string &text) {
+// the members are declared so that the sessions go before the mapped model
+TtsModel::~TtsModel() = default;
 
-    std::vector<std::string> ret;
-    std::string cur;
-    int cur_len = -1;
-    for (size_t i = 0, len = 0; i < text.length(); i += len) {
-        unsigned char byte = (unsigned)text[i];
-        if (byte >= 0xFC) // lenght 6
-            len = 6;
-        else if (byte >= 0xF8)
-            len = 5;
-        else if (byte >= 0xF0)
-            len = 4;
-        else if (byte >= 0xE0)
-            len = 3;
-        else if (byte >= 0xC0)
-            len = 2;
-        else
-            len = 1;
-        auto sub = text.substr(i, len);
-        
-        bool is_punc  = _punc_set.count(text[i]);
-        int tmp_len = is_punc ? 0 :len;
+bool TtsModel::findWord(std::string_view word, const int32_t *&ids,
+                        size_t &num_ids) const {
+  if (_binary_lexicon) {
+    return _binary_lexicon->find(word, ids, num_ids);
+  }
+  const LexiconEntry *entry = _word2ids.find(word);
+  if (entry == nullptr) {
+    return false;
+  }
+  ids = _lexicon_ids.data() + entry->offset;
+  num_ids = entry->size;
+  return true;
+}
 
-        if (cur_len != -1 and tmp_len != cur_len) {
-            if (cur_len == 1) {
-                std::transform(cur.begin(), cur.end(), cur.begin(),
-                        [](unsigned char c) { return std::tolower(c); });
-            }
-            if (cur != " ") {
-                ret.push_back(cur);
-            }
-            cur = "";
+int64_t TtsModel::tokenId(std::string_view token) const {
+  const int32_t *id = _token2id.find(token);
+  return id == nullptr ? -1 : *id;
+}
+
+const float *TtsModel::voice(const std::string &name) const {
+  auto it = _voices.find(name);
+  if (it == _voices.end()) {
+    throw std::invalid_argument("unknown voice: " + name);
+  }
+  return it->second;
+}
+
+const float *TtsModel::styleFor(const std::string &name, size_t num_tokens) const {
+  const float *data = voice(name);
+  int64_t emb_dim = _style_dims[2];
+  num_tokens = std::min<size_t>(num_tokens, _style_dims[0] - 1);
+  return data + emb_dim * num_tokens;
+}
+
+std::vector<std::pair<size_t, size_t>>
+TtsModel::splitTokens(const int64_t *token_ids, size_t num_tokens,
+                      size_t max_tokens) const {
+  std::vector<std::pair<size_t, size_t>> ranges;
+  splitTokens(token_ids, num_tokens, max_tokens, ranges);
+  return ranges;
+}
+
+void TtsModel::splitTokens(const int64_t *token_ids, size_t num_tokens, size_t max_tokens,
+                           std::vector<std::pair<size_t, size_t>> &ranges) const {
+  ranges.clear();
+  max_tokens = std::max<size_t>(1, max_tokens);
+  size_t begin = 0;
+  while (num_tokens - begin > max_tokens) {
+    size_t limit = begin + max_tokens;
+    // search the second half only, short chunks waste a Run
+    size_t min_end = begin + max_tokens / 2;
+    size_t end = 0;
+    for (auto *ids : {&_sentence_end_ids, &_phrase_end_ids}) {
+      for (size_t i = limit; i > min_end && end == 0; --i) {
+        if (ids->count(token_ids[i - 1])) {
+          end = i;
         }
-        cur += sub;
-        cur_len = tmp_len;
+      }
+    }
+    for (size_t i = limit; i > min_end && end == 0; --i) {
+      if (token_ids[i - 1] == _space_id) {
+        end = i;
+      }
+    }
+    if (end == 0) {
+      end = limit;
+    }
+    ranges.emplace_back(begin, end);
+    begin = end;
+  }
+  if (begin < num_tokens) {
+    ranges.emplace_back(begin, num_tokens);
+  }
+}
+
+/* --------------------context------------------ */
+// Run with the terminate flag of its RunOptions tied to cancel. With
+// shrink_arena the cpu arena releases its unused chunks at the end of the Run.
+static void run_session(Ort::Session &session, Ort::IoBinding &binding,
+                        CancellationToken *cancel, bool shrink_arena = false) {
+  Ort::RunOptions options =
+      cancel || shrink_arena ? Ort::RunOptions() : Ort::RunOptions(nullptr);
+  if (shrink_arena) {
+    options.AddConfigEntry("memory.enable_memory_arena_shrinkage", "cpu:0");
+  }
+  CancellationScope scope(cancel, options);
+  try {
+    session.Run(options, binding);
+  } catch (const Ort::Exception &) {
+    if (cancel != nullptr && cancel->cancelled()) {
+      throw TtsCancelled();
     }
-    if (cur.size() > 0) {
-        if (cur != " ") {
-            ret.push_back(cur);
+    throw;
+  }
+}
+
+// The outputs of the last Run, the binding is cleared so that an idle pooled
+// session does not keep them (and its inputs) alive in the arena.
+static std::vector<Ort::Value> take_outputs(Ort::IoBinding &binding) {
+  std::vector<Ort::Value> outputs = binding.GetOutputValues();
+  binding.ClearBoundInputs();
+  binding.ClearBoundOutputs();
+  return outputs;
+}
+
+TtsContext::TtsContext(std::shared_ptr<const TtsModel> model)
+    : _model(std::move(model)) {}
+
+std::vector<std::string> TtsContext::split_ch_eng(const std::string &text) {
+    splitParts(text);
+    return std::vector<std::string>(_parts.begin(), _parts.end());
+}
+
+// Runs of english, of hanzi and of punctuation, the english lowercased, the
+// lone spaces dropped. Only ascii is lowercased and the hanzi and punctuation
+// runs hold no ascii letter, so the whole text is lowercased once into _text.
+void TtsContext::splitParts(const std::string &text) {
+    _text.assign(text);
+    for (auto &c : _text) {
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+    }
+    _parts.clear();
+    auto add_part = [&](size_t begin, size_t end) {
+        std::string_view part(_text.data() + begin, end - begin);
+        if (part != " ") {
+            _parts.push_back(part);
+        }
+    };
+    size_t begin = 0;
+    int cur_len = -1;
+    // a new part starts at i when the class (0 punctuation, else the utf8
+    // length) changes
+    auto next = [&](size_t i, int tmp_len) {
+        if (cur_len != -1 and tmp_len != cur_len) {
+            add_part(begin, i);
+            begin = i;
         }
+        cur_len = tmp_len;
+    };
+    const bool *ascii_punc = _model->_ascii_punc;
+    utf8_for_each_run(
+        _text,
+        [&](std::string_view run) {
+            size_t offset = run.data() - _text.data();
+            for (size_t i = 0; i < run.size(); ++i) {
+                next(offset + i, ascii_punc[(unsigned char)run[i]] ? 0 : 1);
+            }
+        },
+        [&](std::string_view ch) {
+            bool is_punc  = _model->_punc_set.count(ch[0]);
+            next(ch.data() - _text.data(), is_punc ? 0 : utf8_len(ch[0]));
+        });
+    if (begin < _text.length()) {
+        add_part(begin, _text.length());
     }
-    for (const auto& p : ret) {
+    for (const auto& p : _parts) {
         std::cout << "convert:" << p << std::endl;
     }
-    return ret;
 }
 
-void Tts::infer(std::vector<int64_t>& tokenids, 
-                std::vector<float>& style,
-                float speed,
-                std::vector<float>& out_audio) {
+size_t TtsModel::maxSamples(size_t num_tokens, float speed) const {
+  if (speed <= 0) {
+    speed = 1.0f;
+  }
+  return num_tokens * _max_frames_per_token * _samples_per_frame / speed + _samples_per_frame;
+}
+
+void TtsContext::infer(std::vector<int64_t>& tokenids, 
+                       std::vector<float>& style,
+                       float speed,
+                       std::vector<float>& out_audio) {
+  infer(tokenids.data(), tokenids.size(), style.data(), speed, out_audio);
+}
+
+void TtsContext::infer(const int64_t *token_ids, size_t num_tokens,
+                       const float *style, float speed,
+                       std::vector<float> &out_audio, CancellationToken *cancel) {
+  if (_model->_two_stage) {
+    inferStream(token_ids, num_tokens, style, speed, [&](const float *samples, size_t n) {
+      out_audio.insert(out_audio.end(), samples, samples + n);
+    }, cancel);
+    return;
+  }
+  size_t num_samples = 0;
+  Ort::Value audio = runSession(token_ids, num_tokens, style, speed, num_samples,
+                                nullptr, cancel);
+  const float *data = audio.GetTensorData<float>();
+  out_audio.insert(out_audio.end(), data, data + num_samples);
+}
+
+size_t TtsContext::infer(const int64_t *token_ids, size_t num_tokens,
+                         const float *style, float speed, float *out,
+                         size_t capacity, CancellationToken *cancel) {
+  size_t num_samples = 0;
+  if (_model->_two_stage) {
+    inferStream(token_ids, num_tokens, style, speed, [&](const float *samples, size_t n) {
+      if (num_samples < capacity) {
+        memcpy(out + num_samples, samples, std::min(n, capacity - num_samples) * sizeof(float));
+      }
+      num_samples += n;
+    }, cancel);
+    if (num_samples > capacity) {
+      std::cout << "audio of " << num_samples << " samples truncated to the capacity of "
+                << capacity << std::endl;
+    }
+    return num_samples;
+  }
+  Ort::Value audio = runSession(token_ids, num_tokens, style, speed, num_samples,
+                                nullptr, cancel);
+  memcpy(out, audio.GetTensorData<float>(),
+         std::min(num_samples, capacity) * sizeof(float));
+  if (num_samples > capacity) {
+    std::cout << "audio of " << num_samples << " samples truncated to the capacity of "
+              << capacity << std::endl;
+  }
+  return num_samples;
+}
+
+void TtsContext::inferStream(const int64_t *token_ids, size_t num_tokens,
+                             const float *style, float speed,
+                             const AudioSink &sink, CancellationToken *cancel) {
+  if (_model->_two_stage) {
+    runTwoStage(token_ids, num_tokens, style, speed, sink, nullptr, cancel);
+    return;
+  }
+  size_t num_samples = 0;
+  Ort::Value audio = runSession(token_ids, num_tokens, style, speed, num_samples,
+                                nullptr, cancel);
+  sink(audio.GetTensorData<float>(), num_samples);
+}
+
+bool TtsContext::shrinkArena(size_t num_tokens) const {
+  int32_t threshold = _model->_config.arena_shrink_tokens;
+  return threshold > 0 && num_tokens >= (size_t)threshold;
+}
 
-  /*
-  auto tmp = load_vec("/home/nanxun/Documents/sherpa-onnx/scripts/kokoro/v1.1-zh/tokenids.txt");
-  for (auto t :vec) {
-    tokenids.push_back(int64_t(t));
+size_t TtsContext::paddedLength(size_t num_tokens) const {
+  const TtsModel &model = *_model;
+  if (!model._bucketing) {
+    return num_tokens;
+  }
+  for (auto len : model._config.bucket_lengths) {
+    if (len >= (int32_t)num_tokens) {
+      return std::min<size_t>(len, model._max_len);
+    }
+  }
+  return num_tokens;
+}
+
+Ort::Value TtsContext::runSession(const int64_t *token_ids,
+                                  size_t num_tokens, const float *style,
+                                  float speed, size_t &num_samples,
+                                  SessionPool::Lease *lease,
+                                  CancellationToken *cancel) {
+  const TtsModel &model = *_model;
+  // With length buckets the tokens are padded with 0 up to the bucket, so ORT
+  // sees the same few shapes again and again and can reuse its memory plans
+  // and arena chunks. The audio of the padding is cut with the durations.
+  size_t padded_len = paddedLength(num_tokens);
+  if (padded_len != num_tokens) {
+    _padded.assign(token_ids, token_ids + num_tokens);
+    _padded.resize(padded_len, 0);
+    token_ids = _padded.data();
   }
-  style  = load_vec("/home/nanxun/Documents/sherpa-onnx/scripts/kokoro/v1.1-zh/style.txt");
-  */
 
   Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(
       OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
-  int64_t dims[2]; dims[0] = 1; dims[1] = tokenids.size();
+  // inputs are wrapped, not copied
+  int64_t dims[2] = {1, (int64_t)padded_len};
   auto token_ort = Ort::Value::CreateTensor<int64_t>(
-      memory_info, tokenids.data(), tokenids.size(), dims, 2);
+      memory_info, const_cast<int64_t *>(token_ids), padded_len, dims, 2);
 
   auto style_ort = Ort::Value::CreateTensor<float>(
-      memory_info, style.data() , style.size(),
-      &_style_dims[1], 2);
+      memory_info, const_cast<float *>(style),
+      model._style_dims[1] * model._style_dims[2],
+      &model._style_dims[1], 2);
 
   int64_t speed_dim[1] =  {1};
   auto speed_ort = Ort::Value::CreateTensor<float>(memory_info, &speed, 1, 
           speed_dim, 1);
-                                                   
 
-  std::vector<Ort::Value> ort_inputs;
-  ort_inputs.emplace_back(std::move(token_ort));
-  ort_inputs.emplace_back(std::move(style_ort));
-  ort_inputs.emplace_back(std::move(speed_ort));
+  // The output length depends on the predicted durations, ORT rejects a
+  // pre-bound output whose shape does not match, so it cannot be bound to the
+  // caller buffer up front. It stays in the ORT arena and the caller copies it
+  // exactly once to its destination.
+  std::unique_ptr<SessionPool::Lease> own_lease;
+  if (lease == nullptr) {
+    own_lease = std::make_unique<SessionPool::Lease>(model._sessions->acquire());
+    lease = own_lease.get();
+  }
+  Ort::IoBinding &binding = lease->binding();
+  binding.ClearBoundInputs();
+  binding.BindInput(model.input_names_[0], token_ort);
+  binding.BindInput(model.input_names_[1], style_ort);
+  binding.BindInput(model.input_names_[2], speed_ort);
+  binding.ClearBoundOutputs();
+  binding.BindOutput(model.output_names_[0], memory_info);
+  if (model._bucketing) {
+    binding.BindOutput(model.output_names_[model._durations_output], memory_info);
+  }
 
-  std::vector<Ort::Value> output_tensors = session_->Run(
-      Ort::RunOptions{nullptr}, input_names_.data(), ort_inputs.data(),
-      ort_inputs.size(), output_names_.data(), output_names_.size());
+  run_session(lease->session(), binding, cancel, shrinkArena(padded_len));
 
+  std::vector<Ort::Value> output_tensors = take_outputs(binding);
   if (output_tensors.empty() || !output_tensors.front().IsTensor()) {
       throw std::runtime_error("Invalid output tensors");
   }
+  num_samples = output_tensors.front().GetTensorTypeAndShapeInfo().GetElementCount();
+  if (padded_len != num_tokens) {
+    const int64_t *durations = output_tensors[1].GetTensorData<int64_t>();
+    int64_t frames = 0;
+    for (size_t t = 0; t < num_tokens; ++t) {
+      frames += durations[t];
+    }
+    num_samples = std::min<size_t>(num_samples, frames * model._samples_per_frame);
+  }
+  return std::move(output_tensors.front());
+}
+
+void TtsContext::runTwoStage(const int64_t *token_ids, size_t num_tokens,
+                             const float *style, float speed,
+                             const AudioSink &sink, SessionPool::Lease *lease,
+                             CancellationToken *cancel) {
+  const TtsModel &model = *_model;
+  Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(
+      OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+  int64_t dims[2] = {1, (int64_t)num_tokens};
+  auto token_ort = Ort::Value::CreateTensor<int64_t>(
+      memory_info, const_cast<int64_t *>(token_ids), num_tokens, dims, 2);
+  auto style_ort = Ort::Value::CreateTensor<float>(
+      memory_info, const_cast<float *>(style),
+      model._style_dims[1] * model._style_dims[2],
+      &model._style_dims[1], 2);
+  int64_t speed_dim[1] = {1};
+  auto speed_ort = Ort::Value::CreateTensor<float>(memory_info, &speed, 1,
+                                                   speed_dim, 1);
+
+  // encoder: the features of the whole utterance, they stay in the ORT arena
+  std::vector<Ort::Value> features;
+  {
+    std::unique_ptr<SessionPool::Lease> own_lease;
+    if (lease == nullptr) {
+      own_lease = std::make_unique<SessionPool::Lease>(model._sessions->acquire());
+      lease = own_lease.get();
+    }
+    Ort::IoBinding &binding = lease->binding();
+    binding.ClearBoundInputs();
+    binding.BindInput(model.input_names_[0], token_ort);
+    binding.BindInput(model.input_names_[1], style_ort);
+    binding.BindInput(model.input_names_[2], speed_ort);
+    binding.ClearBoundOutputs();
+    for (auto name : model.output_names_) {
+      binding.BindOutput(name, memory_info);
+    }
+    run_session(lease->session(), binding, cancel, shrinkArena(num_tokens));
+    features = take_outputs(binding);
+  }
+
+  // frames of the utterance, and per decoder input the values per frame
+  // along the last axis (rate) and the number of rows in front of it
+  size_t num_inputs = model._decoder_feeds.size();
+  std::vector<std::vector<int64_t>> shapes(num_inputs);
+  std::vector<int64_t> rates(num_inputs, 0), rows(num_inputs, 0);
+  int64_t num_frames = -1;
+  for (size_t i = 0; i < num_inputs; ++i) {
+    int32_t feed = model._decoder_feeds[i];
+    if (feed < 0) {
+      continue;
+    }
+    shapes[i] = features[feed].GetTensorTypeAndShapeInfo().GetShape();
+    int64_t len = shapes[i].back();
+    if (num_frames < 0) {
+      num_frames = len;
+    }
+    if (num_frames == 0 || len % num_frames != 0) {
+      throw std::runtime_error(std::string("decoder input ") +
+                               model.decoder_input_names_[i] +
+                               " is not at a multiple of the frame rate");
+    }
+    rates[i] = len / num_frames;
+    rows[i] = features[feed].GetTensorTypeAndShapeInfo().GetElementCount() / len;
+  }
+
+  // decoder: windows of window frames advancing by window - overlap, the
+  // overlap is crossfaded so the window edges do not click. The tail of a
+  // window is held back until the next one is decoded.
+  int64_t window = model._config.decoder_window_frames;
+  int64_t overlap = model._config.decoder_overlap_frames;
+  size_t fade = overlap * model._samples_per_frame;
+  _window_inputs.resize(num_inputs);
+  _tail.clear();
+  for (int64_t start = 0; start < num_frames; start += window - overlap) {
+    int64_t end = std::min(num_frames, start + window);
+    bool last = end == num_frames;
+    {
+      std::vector<Ort::Value> inputs;
+      for (size_t i = 0; i < num_inputs; ++i) {
+        int32_t feed = model._decoder_feeds[i];
+        if (feed < 0) {
+          int64_t d = model.decoder_input_dims_[i].back();
+          if (d <= 0 || d > model._style_dims[2]) {
+            d = model._style_dims[2];
+          }
+          int64_t style_dims[2] = {1, d};
+          inputs.push_back(Ort::Value::CreateTensor<float>(
+              memory_info, const_cast<float *>(style), d, style_dims, 2));
+          continue;
+        }
+        int64_t len = shapes[i].back();
+        int64_t n = (end - start) * rates[i];
+        const float *src = features[feed].GetTensorData<float>();
+        std::vector<float> &dst = _window_inputs[i];
+        dst.resize(rows[i] * n);
+        for (int64_t r = 0; r < rows[i]; ++r) {
+          memcpy(dst.data() + r * n, src + r * len + start * rates[i], n * sizeof(float));
+        }
+        std::vector<int64_t> shape = shapes[i];
+        shape.back() = n;
+        inputs.push_back(Ort::Value::CreateTensor<float>(
+            memory_info, dst.data(), dst.size(), shape.data(), shape.size()));
+      }
+
+      SessionPool::Lease decoder = model._decoder_sessions->acquire();
+      Ort::IoBinding &binding = decoder.binding();
+      binding.ClearBoundInputs();
+      for (size_t i = 0; i < num_inputs; ++i) {
+        binding.BindInput(model.decoder_input_names_[i], inputs[i]);
+      }
+      binding.ClearBoundOutputs();
+      binding.BindOutput(model.decoder_output_names_[0], memory_info);
+      // the windows have a fixed size, the utterance length decides
+      run_session(decoder.session(), binding, cancel,
+                  last && shrinkArena(num_tokens));
+      std::vector<Ort::Value> audio = take_outputs(binding);
+      const float *data = audio.front().GetTensorData<float>();
+      _window_audio.assign(
+          data, data + audio.front().GetTensorTypeAndShapeInfo().GetElementCount());
+    }
+
+    size_t n = _window_audio.size();
+    size_t head = std::min(_tail.size(), n);
+    for (size_t k = 0; k < head; ++k) {
+      float w = (k + 0.5f) / head;
+      _window_audio[k] = _tail[k] * (1 - w) + _window_audio[k] * w;
+    }
+    size_t keep = last ? n : n - std::min(n, fade);
+    _tail.assign(_window_audio.begin() + keep, _window_audio.end());
+    // the decoder session is already released, a slow sink does not hold it
+    if (keep > 0) {
+      sink(_window_audio.data(), keep);
+    }
+    if (last) {
+      break;
+    }
+  }
+}
+
+void TtsContext::inferBatch(const std::vector<int64_t> &token_ids,
+                            const std::vector<size_t> &lengths,
+                            const std::vector<float> &styles,
+                            const std::vector<float> &speeds,
+                            std::vector<std::vector<float>> &out_audio) {
+  const TtsModel &model = *_model;
+  if (!model._batch_capable) {
+    throw std::runtime_error("kokoro model is not exported with batch support");
+  }
+  int64_t batch = lengths.size();
+  int64_t max_len = token_ids.size() / batch;
+
+  Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(
+      OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+  int64_t token_dims[2] = {batch, max_len};
+  auto token_ort = Ort::Value::CreateTensor<int64_t>(
+      memory_info, const_cast<int64_t *>(token_ids.data()), token_ids.size(),
+      token_dims, 2);
+  int64_t style_dims[2] = {batch, model._style_dims[2]};
+  auto style_ort = Ort::Value::CreateTensor<float>(
+      memory_info, const_cast<float *>(styles.data()), styles.size(),
+      style_dims, 2);
+  int64_t speed_dims[1] = {batch};
+  auto speed_ort = Ort::Value::CreateTensor<float>(
+      memory_info, const_cast<float *>(speeds.data()), speeds.size(),
+      speed_dims, 1);
+
+  SessionPool::Lease lease = model._sessions->acquire();
+  Ort::IoBinding &binding = lease.binding();
+  binding.ClearBoundInputs();
+  binding.BindInput(model.input_names_[0], token_ort);
+  binding.BindInput(model.input_names_[1], style_ort);
+  binding.BindInput(model.input_names_[2], speed_ort);
+  binding.ClearBoundOutputs();
+  binding.BindOutput(model.output_names_[0], memory_info);
+  binding.BindOutput(model.output_names_[model._durations_output], memory_info);
+
+  run_session(lease.session(), binding, nullptr, shrinkArena(token_ids.size()));
+
+  // audio [B, S] is padded to the longest item, durations [B, T] are the
+  // frames of every token. The padding tokens come last, so the audio of an
+  // item is the first sum(durations of its real tokens) frames of its row.
+  std::vector<Ort::Value> output_tensors = take_outputs(binding);
+  if (output_tensors.size() != 2) {
+      throw std::runtime_error("Invalid output tensors");
+  }
+  std::vector<int64_t> audio_shape =
+      output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
+  int64_t num_samples = audio_shape.back();
+  const float *audio = output_tensors[0].GetTensorData<float>();
+  const int64_t *durations = output_tensors[1].GetTensorData<int64_t>();
 
-  auto info = output_tensors.front().GetTensorTypeAndShapeInfo();
-  std::vector<int64_t> shape = info.GetShape();
-  std::cout << "shape: ";
-  for (auto s :shape) {
-      std::cout << s << " ";
+  out_audio.resize(batch);
+  for (int64_t b = 0; b < batch; ++b) {
+    int64_t frames = 0;
+    for (size_t t = 0; t < lengths[b]; ++t) {
+      frames += durations[b * max_len + t];
+    }
+    int64_t n = std::min(frames * model._samples_per_frame, num_samples);
+    out_audio[b].assign(audio + b * num_samples, audio + b * num_samples + n);
   }
-  std::cout <<std::endl;
+}
 
-  float *logits_data = output_tensors.front().GetTensorMutableData<float>();
-  size_t element_count = info.GetElementCount();
-  out_audio.insert(out_audio.end(), logits_data, logits_data + element_count);
-  //sherpa_onnx::WriteWave(std::string("out.wav"), _sample_rate, logits_data, element_count);
+void TtsContext::run(const std::string &text, const std::string &voice, std::vector<float>& out_audio,
+                     CancellationToken *cancel) {
+    model().voice(voice); // fail before the front end work
+    if (cancel) cancel->check();
+    // a text longer than one Run takes is synthesized chunk by chunk
+    tokenizeChunks(text, _chunks);
+    for (auto &ids : _chunks) {
+        const float *style = model().styleFor(voice, ids.size());
+        infer(ids.data(), ids.size(), style, 0.85, out_audio, cancel);
+    }
 }
 
-void Tts::run(const std::string &text, const std::string &voice, std::vector<float>& out_audio) {
-    std::vector<std::string> parts = split_ch_eng(text);
+void TtsContext::runStream(const std::string &text, const std::string &voice,
+                           const AudioSink &sink, CancellationToken *cancel) {
+    model().voice(voice);
+    if (cancel) cancel->check();
+    tokenizeChunks(text, _chunks);
+    for (auto &ids : _chunks) {
+        const float *style = model().styleFor(voice, ids.size());
+        inferStream(ids.data(), ids.size(), style, 0.85, sink, cancel);
+    }
+}
 
-    std::vector<std::string> tokens;
-    for (const auto& sent: parts) {
+void TtsContext::tokenize(const std::string &text, std::vector<int64_t> &token_ids) {
+    tokenizeAll(text, token_ids);
+    if (token_ids.size() > _model->_max_len) {
+        std::cout << "truncate " << token_ids.size() << " tokens to " << _model->_max_len
+                  << ", use tokenizeChunks for long text" << std::endl;
+        token_ids.resize(_model->_max_len);
+    }
+}
+
+void TtsContext::tokenizeChunks(const std::string &text,
+                                std::vector<std::vector<int64_t>> &chunks) {
+    const TtsModel &model = *_model;
+    tokenizeAll(text, _token_ids);
+    // ranges of the ids after the leading 0, each chunk gets its own 0
+    auto &ranges = _ranges;
+    model.splitTokens(_token_ids.data() + 1, _token_ids.size() - 1,
+                      model._max_len - 1, ranges);
+    // a text without any known token still gives the single [0] chunk
+    chunks.resize(std::max<size_t>(1, ranges.size()));
+    chunks.front().assign(1, 0);
+    for (size_t c = 0; c < ranges.size(); ++c) {
+        chunks[c].assign(1, 0);
+        chunks[c].insert(chunks[c].end(), _token_ids.begin() + 1 + ranges[c].first,
+                         _token_ids.begin() + 1 + ranges[c].second);
+    }
+}
+
+void TtsContext::tokenizeAll(const std::string &text, std::vector<int64_t> &token_ids) {
+    const TtsModel &model = *_model;
+    splitParts(text);
+
+    // the lexicons hold token ids, a word is one lookup and a copy
+    auto add_word = [&](std::string_view word) {
+        const int32_t *ids;
+        size_t num_ids;
+        if (!model.findWord(word, ids, num_ids)) {
+            return false;
+        }
+        token_ids.insert(token_ids.end(), ids, ids + num_ids);
+        return true;
+    };
+
+    token_ids.clear();
+    token_ids.push_back(0);
+    for (std::string_view sent : _parts) {
         unsigned char byte = (unsigned)sent[0]; 
-        if (_punc_set.count(sent[0])) {
-            //std::cout << "add token:" <<sent<<std::endl;
+        if (model._punc_set.count(sent[0])) {
             for (auto s :sent)  {
-                std::string tmp(1, s);
-                tokens.push_back(tmp);
-                //tokens.push_back(" ");
+                int64_t id = model.tokenId(std::string_view(&s, 1));
+                if (id < 0) {
+                    std::cout << "skip token:" << s << std::endl;
+                    continue;
+                }
+                token_ids.push_back(id);
             }
         } else if (byte < 0xC0) {  // eng
-            if (_word2token.count(sent)) {
-                //std::cout << "add token:" <<sent<<std::endl;
-                tokens.insert(tokens.end(), _word2token[sent].begin(), _word2token[sent].end());
-            } else {
+            if (!add_word(sent)) {
                 std::cout << "skip eng:" <<  sent << std::endl;
             }
         } else  {
-            std::vector<std::string> out;
-            _jieba->Cut(sent, out);
-            for (auto& o: out) {
-                if (_word2token.count(o)) {
-                    //std::cout << "add token:" <<o<<std::endl;
-                    tokens.insert(tokens.end(), _word2token[o].begin(), _word2token[o].end());
-                } else {
+            // repeated phrases skip jieba and the lexicons
+            G2pCache *cache = model._g2p_cache.get();
+            if (cache && cache->lookup(sent, token_ids)) {
+                continue;
+            }
+            size_t begin = token_ids.size();
+            _sentence.assign(sent.data(), sent.size());
+            _words.clear();
+            model._jieba->Cut(_sentence, _words);
+            for (auto& o: _words) {
+                if (!add_word(o)) {
                     // split into single hanzi
-                    for (auto hanzi : utf8_to_charset(o))  {
-                        //std::cout << "add token:" <<hanzi<<std::endl;
-                        if (_word2token.count(hanzi)) {
-                            tokens.insert(tokens.end(), _word2token[hanzi].begin(), _word2token[hanzi].end());
-                        }  else {
+                    utf8_for_each(o, [&](std::string_view hanzi) {
+                        if (!add_word(hanzi)) {
                             std::cout << "skip ch:" <<  sent << std::endl;
                         }
-                    }
+                    });
                 }
             }
+            if (cache) {
+                cache->insert(sent, token_ids.data() + begin, token_ids.size() - begin);
+            }
         }
     }
-
-    std::vector<int64_t> token_ids;
-    token_ids.push_back(0);
-    for (auto& str : tokens) {
-        token_ids.push_back(_token2id[str]);
-        //std::cout << "token_ids:" << str << " " << _token2id[str] << std::endl;
-    }
-    if (token_ids.size() > _max_len) {
-        token_ids.resize(_max_len);
-    }
-    //token_ids.push_back(0);
-
-    std::vector<float> style;
-    int64_t emb_dim = _style_dims[2]; 
-    style.assign(_voices[voice].begin() + emb_dim * token_ids.size(), _voices[voice].begin() + emb_dim *token_ids.size() + emb_dim);
-
-    infer(token_ids , style, 0.85, out_audio);
 }
 
-void Tts::setupIO() {
-  Ort::AllocatorWithDefaultOptions allocator;
-
-  // 获取输入信息
-  size_t num_input_nodes = session_->GetInputCount();
-  input_names_.reserve(num_input_nodes);
-
-  for (size_t i = 0; i < num_input_nodes; i++) {
-    auto input_name = session_->GetInputNameAllocated(i, allocator);
-
-    char *dest = new char[strlen(input_name.get()) + 1]; // +1 用于空终止符
-    input_names_.push_back(dest);
-    strcpy(dest, input_name.get());
-
-    Ort::TypeInfo type_info = session_->GetInputTypeInfo(i);
-    auto tensor_info = type_info.GetTensorTypeAndShapeInfo();
-
-    std::vector<int64_t> input_dims = tensor_info.GetShape();
-    std::cout << "Input " << i << " name: " << dest << std::endl;
-    std::cout << "Input shape: ";
-    for (auto dim : input_dims) {
-      std::cout << dim << " ";
+std::vector<WarmupTiming> TtsContext::warmup() {
+  const TtsModel &model = *_model;
+  std::vector<std::string> voices = model._config.warmup_voices;
+  if (voices.empty()) {
+    for (auto &v : model._voices) {
+      voices.push_back(v.first);
     }
-    input_dims_.push_back(input_dims);
-    std::cout << std::endl;
+  }
+  if (voices.empty()) {
+    return {};
   }
 
-  // 获取输出信息
-  size_t num_output_nodes = session_->GetOutputCount();
-  output_names_.reserve(num_output_nodes);
-
-  for (size_t i = 0; i < num_output_nodes; i++) {
-    auto output_name = session_->GetOutputNameAllocated(i, allocator);
-    char *dest = new char[strlen(output_name.get()) + 1];
-    strcpy(dest, output_name.get());
-    output_names_.push_back(dest);
-
-    Ort::TypeInfo type_info = session_->GetOutputTypeInfo(i);
-    auto tensor_info = type_info.GetTensorTypeAndShapeInfo();
+  // tile the tokens of the probe sentences up to the wanted lengths
+  std::vector<int64_t> probe;
+  tokenize("你好，欢迎使用语音合成服务。Hello, how are you doing today?", probe);
+  if (probe.size() < 2) {
+    std::cout << "warmup skipped, the probe sentence gives no tokens" << std::endl;
+    return {};
+  }
+  std::vector<size_t> lengths = {16, (size_t)model._max_len / 2,
+                                 (size_t)model._max_len - 2};
+  auto probe_of_length = [&](size_t n) {
+    std::vector<int64_t> ids(probe);
+    while (ids.size() < n) {
+      ids.insert(ids.end(), probe.begin() + 1, probe.end());
+    }
+    ids.resize(std::min(n, (size_t)model._max_len));
+    return ids;
+  };
 
-    std::vector<int64_t> output_dims = tensor_info.GetShape();
-    std::cout << "Output " << i << " name: " << dest << std::endl;
-    std::cout << "Output shape: ";
-    for (auto dim : output_dims) {
-      std::cout << dim << " ";
+  // The arena and the kernels only depend on the shapes, so the long probes
+  // run with the first voice. Every voice runs the short one, which pages in
+  // its style table.
+  // Every session has its own arena to grow. They are leased one at a time,
+  // so live traffic and other warmups keep the rest of the pool.
+  std::vector<WarmupTiming> timings;
+  for (size_t session = 0; session < model._sessions->size(); ++session) {
+    SessionPool::Lease lease = model._sessions->acquire(session);
+    for (size_t v = 0; v < voices.size(); ++v) {
+      for (size_t n : lengths) {
+        if (v > 0 && n != lengths.front()) {
+          continue;
+        }
+        std::vector<int64_t> ids = probe_of_length(n);
+        size_t num_samples = 0;
+        const float *style = model.styleFor(voices[v], ids.size());
+        auto start = std::chrono::steady_clock::now();
+        if (model._two_stage) {
+          // the decoder windows run on whichever decoder session is idle
+          runTwoStage(ids.data(), ids.size(), style, 1.0f,
+                      [](const float *, size_t) {}, &lease);
+        } else {
+          runSession(ids.data(), ids.size(), style, 1.0f, num_samples,
+                     &lease);
+        }
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+        timings.push_back({voices[v], ids.size(), session, ms});
+        if (v == 0) {
+          std::cout << "warmup session " << session << " voice " << voices[v]
+                    << " tokens " << ids.size() << ": " << ms << " ms" << std::endl;
+        }
+      }
     }
-    std::cout << std::endl;
   }
+  return timings;
 }
 
-void Tts::getCustomMetadataMap(std::map<std::string, std::string> &data) {
+void TtsModel::setupIO() {
+  read_io(_sessions->session(0), input_names_, input_dims_, output_names_, _io_names);
+}
+
+void TtsModel::getCustomMetadataMap(std::map<std::string, std::string> &data) {
   Ort::AllocatorWithDefaultOptions allocator;
-  Ort::ModelMetadata model_metadata = session_->GetModelMetadata();
+  Ort::ModelMetadata model_metadata = _sessions->session(0).GetModelMetadata();
 
   // 获取自定义元数据数量
   auto keys = model_metadata.GetCustomMetadataMapKeysAllocated(allocator);
@@ -402,3 +1215,35 @@ void Tts::getCustomMetadataMap(std::map<std::string, std::string> &data) {
     data[std::string(key)] = std::string(value.get());
   }
 }
+
+/* --------------------tts------------------ */
+Tts::Tts(const std::string &kokoro_onnx, const std::string &tokens,
+         const std::vector<std::string> &lexicons,
+         const std::string &voices_bin, const std::string &jieba_dir,
+         const TtsConfig &config)
+    : Tts(std::make_shared<const TtsModel>(kokoro_onnx, tokens, lexicons,
+                                           voices_bin, jieba_dir, config)) {}
+
+Tts::Tts(std::shared_ptr<const TtsModel> model)
+    : _sample_rate(model->_sample_rate), _model(model), _context(model) {}
+
+// the workers finish the queued requests before the context goes away
+Tts::~Tts() = default;
+
+TtsExecutor &Tts::executor() {
+  std::call_once(_executor_once,
+                 [this] { _executor = std::make_unique<TtsExecutor>(_model); });
+  return *_executor;
+}
+
+std::future<std::vector<float>> Tts::runAsync(const std::string &text,
+                                              const std::string &voice,
+                                              CancellationToken *cancel) {
+  return executor().runAsync(text, voice, cancel);
+}
+
+bool Tts::runAsync(const std::string &text, const std::string &voice,
+                   std::function<void(std::vector<float>, std::exception_ptr)> done,
+                   CancellationToken *cancel) {
+  return executor().runAsync(text, voice, std::move(done), cancel);
+}
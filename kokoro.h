@@ -5,51 +5,314 @@
     > Created Time: 2025年05月13日 星期二 14时31分39秒
  ************************************************************************/
 #pragma once
+#include "binary_lexicon.h"
+#include "cancellation.h"
 #include "cppjieba/Jieba.hpp"
+#include "g2p_cache.h"
+#include "mapped_file.h"
+#include "session_pool.h"
+#include "string_map.h"
+#include "tts_config.h"
 #include <atomic>
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <onnxruntime_cxx_api.h>
 #include <string>
+#include <string_view>
 #include <thread>
 
-class Tts {
+// receives the audio of an utterance piece by piece, in order
+using AudioSink = std::function<void(const float *samples, size_t n)>;
+
+class TtsExecutor;
+
+// Everything loaded from disk: the ORT sessions, tokens, lexicons, voices and
+// the jieba dictionaries. It is never modified after construction, so a single
+// instance is shared (as std::shared_ptr<const TtsModel>) by all the
+// TtsContext of a process. Each Run leases an idle session of the pool,
+// cppjieba::Jieba::Cut is safe to call from several threads at once.
+class TtsModel {
 public:
-  Tts(const std::string &kokoro_onnx, const std::string &tokens,
-      const std::vector<std::string> &lexicons, const std::string &voice_bin,
-      const std::string &jieba_dir);
-  void run(const std::string &text);
+  TtsModel(const std::string &kokoro_onnx, const std::string &tokens,
+           const std::vector<std::string> &lexicons, const std::string &voice_bin,
+           const std::string &jieba_dir, const TtsConfig &config = TtsConfig());
+  ~TtsModel();
+  TtsModel(const TtsModel &) = delete;
+  TtsModel &operator=(const TtsModel &) = delete;
+
+  TtsConfig _config;
+
+  // With TtsConfig::use_mmap, the mapped model and voices.bin, else voices.bin
+  // is read once into _voices_data. Declared before the session pools, which
+  // may point into them, so that they are destroyed after the pools also when
+  // the constructor throws.
+  std::vector<std::unique_ptr<MappedFile>> _model_files;
+  std::unique_ptr<MappedFile> _voices_file;
+  std::vector<float> _voices_data;
+  // the strings of the *_names_ vectors below
+  std::vector<std::unique_ptr<char[]>> _io_names;
 
-  Ort::Env env_;
   Ort::SessionOptions session_options_;
-  std::unique_ptr<Ort::Session> session_;
+  std::unique_ptr<SessionPool> _sessions;
   std::unique_ptr<cppjieba::Jieba> _jieba;
 
   std::vector<const char *> input_names_;
   std::vector<std::vector<int64_t>> input_dims_;
   std::vector<const char *> output_names_;
   std::set<char> _punc_set;
-
-  void setupIO();
-  void getCustomMetadataMap(std::map<std::string, std::string> &data);
+  bool _ascii_punc[128] = {}; // the ascii ones of _punc_set
 
   int32_t _sample_rate;
   int32_t _max_len;
 
-  std::map<std::string, int32_t> _token2id;
-  std::map<std::string, std::vector<std::string>> _word2token;
-  std::map<std::string, std::vector<float>> _voices; // voice -> 510 x 1 x 256
+  StringMap<int32_t> _token2id;
+  // the lexicons, with the tokens resolved to ids at load time: the ids of a
+  // word are _lexicon_ids[offset, offset + size). A compiled lexicon (a single
+  // .bin lexicon file, see BinaryLexicon) is mapped instead.
+  struct LexiconEntry {
+    uint32_t offset;
+    uint32_t size;
+  };
+  StringMap<LexiconEntry> _word2ids;
+  std::vector<int32_t> _lexicon_ids;
+  std::unique_ptr<BinaryLexicon> _binary_lexicon;
+  // front end results of the hanzi segments, nullptr if
+  // TtsConfig::g2p_cache_bytes is 0. The one mutable part of the model, it
+  // locks internally.
+  std::unique_ptr<G2pCache> _g2p_cache;
+  std::map<std::string, const float *> _voices; // voice -> 510 x 1 x 256, points into the voices.bin data
   std::vector<int64_t> _style_dims;                  // 510 1 256
+  int32_t _samples_per_frame;
+  // average frames per token maxSamples allows, model metadata
+  // "max_frames_per_token" or 12
+  int32_t _max_frames_per_token;
 
-  void run(const std::string &text, const std::string &voice, std::vector<float>& out_data);
-  void infer(std::vector<int64_t>& tokenids, std::vector<float>& style, float speed, std::vector<float>& out_data);
-  std::vector<std::string> split_ch_eng(const std::string &text);
+  // token ids of the boundaries splitTokens cuts at
+  std::set<int64_t> _sentence_end_ids;
+  std::set<int64_t> _phrase_end_ids;
+  int64_t _space_id = -1;
+
+  // batch support, from the model metadata
+  bool _batch_capable = false;
+  int32_t _max_batch_size = 1;
+  int32_t _durations_output = -1; // index in output_names_
+  // pad tokens to TtsConfig::bucket_lengths, needs the durations output
+  bool _bucketing = false;
+
+  // two-stage export (TtsConfig::decoder_model): the sessions above run the
+  // encoder, whose outputs feed the decoder inputs of the same name. The
+  // decoder input named "style" gets the first floats of the style vector.
+  // The first other decoder input must be at the frame rate, e.g. [1, C, F],
+  // the others at an integer multiple of it along the last axis.
+  bool _two_stage = false;
+  std::unique_ptr<SessionPool> _decoder_sessions;
+  std::vector<const char *> decoder_input_names_;
+  std::vector<std::vector<int64_t>> decoder_input_dims_;
+  std::vector<const char *> decoder_output_names_;
+  std::vector<int32_t> _decoder_feeds; // encoder output index per decoder input, -1 for style
+
+  // lookups never insert, unlike StringMap::operator[]
+  // token ids of the word in ids[0, num_ids)
+  // return false if the word is not in the lexicons
+  bool findWord(std::string_view word, const int32_t *&ids, size_t &num_ids) const;
+  // return -1 if the token is unknown
+  int64_t tokenId(std::string_view token) const;
+  // 510 x 1 x 256 style table of the voice
+  // throw std::invalid_argument if the voice is unknown
+  const float *voice(const std::string &name) const;
+  // style vector (256 floats) of voice for an utterance of num_tokens tokens
+  const float *styleFor(const std::string &voice, size_t num_tokens) const;
+
+  // Splits token ids (without the leading 0) into ranges [begin, end) of at
+  // most max_tokens ids. A range ends after the last sentence punctuation
+  // (. ! ? ; :) of its second half, else after a phrase punctuation (, -),
+  // else after a space, else it is cut at max_tokens, so every Run gets close
+  // to the longest input the model takes.
+  std::vector<std::pair<size_t, size_t>> splitTokens(const int64_t *token_ids,
+                                                     size_t num_tokens,
+                                                     size_t max_tokens) const;
+  // the same into ranges, whose capacity is reused
+  void splitTokens(const int64_t *token_ids, size_t num_tokens, size_t max_tokens,
+                   std::vector<std::pair<size_t, size_t>> &ranges) const;
+
+  // samples to reserve for num_tokens tokens, use it to size the caller
+  // buffer of TtsContext::infer(..., out, capacity), then shrink to the
+  // returned length. It bounds the average token length by
+  // _max_frames_per_token, an utterance of unusually long pauses can exceed
+  // it: compare the returned length with the capacity.
+  size_t maxSamples(size_t num_tokens, float speed = 1.0f) const;
 
 private:
+  void addSession(SessionPool &pool, const std::string &model_path,
+                  const Ort::SessionOptions &options);
+  void setupIO();
+  void setupDecoder();
+  void getCustomMetadataMap(std::map<std::string, std::string> &data);
   void load_tokens(const std::string &);
-  void load_lexicons(const std::vector<std::string> &);
+  void load_lexicons(const std::vector<std::string> &, const std::string &token_file);
   int load_voices(const std::vector<std::string> &speaker_names,
                   std::vector<int64_t> &dims, const std::string &voices_bin);
 };
+
+struct WarmupTiming {
+  std::string voice;
+  size_t num_tokens;
+  size_t session;
+  double ms;
+};
+
+// Per-thread state of a synthesis: the scratch buffers of the front end,
+// reused from one request to the next. Cheap to create, one
+// TtsContext must not be used by two threads at the same time.
+// The calls taking a CancellationToken check it between the front end and
+// every Run and terminate the Run in flight when it is cancelled, they throw
+// TtsCancelled then.
+class TtsContext {
+public:
+  explicit TtsContext(std::shared_ptr<const TtsModel> model);
+
+  const TtsModel &model() const { return *_model; }
+
+  void run(const std::string &text, const std::string &voice, std::vector<float>& out_data,
+           CancellationToken *cancel = nullptr);
+  void runStream(const std::string &text, const std::string &voice, const AudioSink &sink,
+                 CancellationToken *cancel = nullptr);
+  // front end only: text -> token ids, starting with the 0 boundary token and
+  // at most _max_len long, the rest of a longer text is dropped
+  void tokenize(const std::string &text, std::vector<int64_t> &token_ids);
+  // text -> one or more token id sequences of at most _max_len ids, each
+  // starting with the 0 boundary token, split with TtsModel::splitTokens
+  void tokenizeChunks(const std::string &text,
+                      std::vector<std::vector<int64_t>> &chunks);
+  void infer(std::vector<int64_t>& tokenids, std::vector<float>& style, float speed, std::vector<float>& out_data);
+  // appends the audio to out_data
+  void infer(const int64_t *token_ids, size_t num_tokens, const float *style,
+             float speed, std::vector<float> &out_data,
+             CancellationToken *cancel = nullptr);
+  // Writes the audio of num_tokens tokens into out[0, capacity) and returns the
+  // number of samples of the utterance. A return value larger than capacity
+  // means the audio was truncated to capacity samples (it is also logged):
+  // grow the buffer to the returned length and run again, or use the
+  // std::vector overload.
+  size_t infer(const int64_t *token_ids, size_t num_tokens, const float *style,
+               float speed, float *out, size_t capacity,
+               CancellationToken *cancel = nullptr);
+  // Hands the audio to sink as it is produced: once for a single graph
+  // model, once per decoder window for a two-stage model, so the first
+  // samples of a long sentence are out after the encoder and one window.
+  void inferStream(const int64_t *token_ids, size_t num_tokens, const float *style,
+                   float speed, const AudioSink &sink,
+                   CancellationToken *cancel = nullptr);
+  // Batch models only (TtsModel::_batch_capable). token_ids is [B, T] padded
+  // with 0, lengths the real length of every row, styles [B, 256] and speeds
+  // [B]. out_data receives the audio of every row, cut to its real length.
+  void inferBatch(const std::vector<int64_t> &token_ids,
+                  const std::vector<size_t> &lengths,
+                  const std::vector<float> &styles,
+                  const std::vector<float> &speeds,
+                  std::vector<std::vector<float>> &out_data);
+  std::vector<std::string> split_ch_eng(const std::string &text);
+
+  // Synthesizes probe sentences at short, medium and near _max_len token
+  // lengths on every session of the pool, so that the ORT arena is grown and
+  // the kernels have touched their memory before live traffic arrives.
+  // Returns the time of every probe.
+  std::vector<WarmupTiming> warmup();
+
+private:
+  // num_samples receives the length of the audio, the tensor may be longer
+  // when the tokens were padded to a bucket
+  // lease is the session to run on, nullptr to take any idle one
+  Ort::Value runSession(const int64_t *token_ids, size_t num_tokens,
+                        const float *style, float speed, size_t &num_samples,
+                        SessionPool::Lease *lease = nullptr,
+                        CancellationToken *cancel = nullptr);
+  size_t paddedLength(size_t num_tokens) const;
+  // a Run of num_tokens tokens is long enough for TtsConfig::arena_shrink_tokens
+  bool shrinkArena(size_t num_tokens) const;
+  // tokenize without the _max_len limit
+  void tokenizeAll(const std::string &text, std::vector<int64_t> &token_ids);
+  // split_ch_eng into _parts, views of _text
+  void splitParts(const std::string &text);
+  // encoder run on lease (nullptr for any idle session), then the decoder
+  // window by window
+  void runTwoStage(const int64_t *token_ids, size_t num_tokens, const float *style,
+                   float speed, const AudioSink &sink,
+                   SessionPool::Lease *lease = nullptr,
+                   CancellationToken *cancel = nullptr);
+
+  std::shared_ptr<const TtsModel> _model;
+
+  // scratch buffers of run(), the front end keeps their capacity between
+  // requests and does not allocate once they have grown (jieba does)
+  std::string _text;
+  std::vector<std::string_view> _parts;
+  std::string _sentence;
+  std::vector<std::string> _words;
+  std::vector<std::pair<size_t, size_t>> _ranges;
+  std::vector<int64_t> _token_ids;
+  std::vector<int64_t> _padded;
+  std::vector<std::vector<int64_t>> _chunks;
+  // scratch buffers of runTwoStage()
+  std::vector<std::vector<float>> _window_inputs;
+  std::vector<float> _window_audio;
+  std::vector<float> _tail;
+};
+
+// A model together with one context, for the single threaded use case.
+// To serve concurrent requests, load one TtsModel and create a TtsContext
+// per worker thread instead, or use runAsync, which runs on a TtsExecutor
+// created on the first call (TtsConfig::async_workers/async_queue_depth).
+class Tts {
+public:
+  Tts(const std::string &kokoro_onnx, const std::string &tokens,
+      const std::vector<std::string> &lexicons, const std::string &voice_bin,
+      const std::string &jieba_dir, const TtsConfig &config = TtsConfig());
+  explicit Tts(std::shared_ptr<const TtsModel> model);
+  ~Tts();
+
+  const TtsModel &model() const { return *_model; }
+  std::shared_ptr<const TtsModel> sharedModel() const { return _model; }
+  TtsContext &context() { return _context; }
+  std::vector<WarmupTiming> warmup() { return _context.warmup(); }
+
+  void run(const std::string &text, const std::string &voice, std::vector<float>& out_data,
+           CancellationToken *cancel = nullptr) {
+    _context.run(text, voice, out_data, cancel);
+  }
+  void runStream(const std::string &text, const std::string &voice, const AudioSink &sink,
+                 CancellationToken *cancel = nullptr) {
+    _context.runStream(text, voice, sink, cancel);
+  }
+  void infer(std::vector<int64_t>& tokenids, std::vector<float>& style, float speed, std::vector<float>& out_data) {
+    _context.infer(tokenids, style, speed, out_data);
+  }
+  size_t infer(const int64_t *token_ids, size_t num_tokens, const float *style,
+               float speed, float *out, size_t capacity,
+               CancellationToken *cancel = nullptr) {
+    return _context.infer(token_ids, num_tokens, style, speed, out, capacity, cancel);
+  }
+  // see TtsExecutor::runAsync, they never block
+  std::future<std::vector<float>> runAsync(const std::string &text, const std::string &voice,
+                                           CancellationToken *cancel = nullptr);
+  bool runAsync(const std::string &text, const std::string &voice,
+                std::function<void(std::vector<float>, std::exception_ptr)> done,
+                CancellationToken *cancel = nullptr);
+  TtsExecutor &executor();
+
+  size_t maxSamples(size_t num_tokens, float speed = 1.0f) const {
+    return _model->maxSamples(num_tokens, speed);
+  }
+
+  const int32_t _sample_rate;
+
+private:
+  std::shared_ptr<const TtsModel> _model;
+  TtsContext _context;
+  std::once_flag _executor_once;
+  std::unique_ptr<TtsExecutor> _executor;
+};
@@ -0,0 +1,41 @@
+/*************************************************************************
+    > File Name: mapped_file.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月18日 星期三 16时03分10秒
+ ************************************************************************/
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path) : _path(path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("fail to open " + path + ": " + strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("fail to stat " + path + ": " + strerror(errno));
+  }
+  _size = st.st_size;
+  if (_size > 0) {
+    _data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd); // the mapping keeps the file alive
+  if (_data == MAP_FAILED) {
+    _data = nullptr;
+    throw std::runtime_error("fail to mmap " + path + ": " + strerror(errno));
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (_data) {
+    munmap(_data, _size);
+  }
+}
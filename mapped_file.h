@@ -0,0 +1,29 @@
+/*************************************************************************
+    > File Name: mapped_file.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月18日 星期三 16时02分45秒
+ ************************************************************************/
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only, shared memory mapping of a whole file. All the processes mapping
+// the same file share its pages in the page cache.
+class MappedFile {
+public:
+  // throw std::runtime_error if the file cannot be opened or mapped
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const void *data() const { return _data; }
+  size_t size() const { return _size; }
+  const std::string &path() const { return _path; }
+
+private:
+  std::string _path;
+  void *_data = nullptr;
+  size_t _size = 0;
+};
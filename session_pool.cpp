@@ -0,0 +1,186 @@
+/*************************************************************************
+    > File Name: session_pool.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月09日 星期一 15时21分02秒
+ ************************************************************************/
+#include "session_pool.h"
+#include "cpu_affinity.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+static std::shared_ptr<Ort::Env> create_env(const TtsConfig &config) {
+  if (!config.use_global_thread_pool) {
+    return std::make_shared<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "kokoro");
+  }
+  Ort::ThreadingOptions tp_options;
+  tp_options.SetGlobalIntraOpNumThreads(config.intraOpThreads());
+  tp_options.SetGlobalInterOpNumThreads(config.inter_op_num_threads);
+  tp_options.SetGlobalSpinControl(config.allow_spinning ? 1 : 0);
+  std::string affinity = ort_thread_affinity(config.affinityCpus(), config.intraOpThreads());
+  if (!affinity.empty()) {
+    Ort::ThrowOnError(Ort::GetApi().SetGlobalIntraOpThreadAffinity(tp_options, affinity.c_str()));
+  }
+  return std::make_shared<Ort::Env>(tp_options, ORT_LOGGING_LEVEL_WARNING, "kokoro");
+}
+
+static void register_arena(Ort::Env &env, const TtsConfig &config) {
+  Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(
+      OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+  Ort::ArenaCfg arena_cfg(config.arena_max_mem, config.arena_extend_strategy,
+                          config.arena_initial_chunk_bytes, -1);
+  env.CreateAndRegisterAllocator(memory_info, arena_cfg);
+}
+
+// the settings of the global thread pools, to compare the configs
+static std::string thread_settings(const TtsConfig &config) {
+  std::ostringstream os;
+  os << config.intraOpThreads() << "/" << config.inter_op_num_threads << "/"
+     << config.allow_spinning << "/"
+     << ort_thread_affinity(config.affinityCpus(), config.intraOpThreads());
+  return os.str();
+}
+
+// ORT keeps a single environment per process, so every pool (the encoder and
+// decoder pools, several models) shares one Ort::Env. The config of the pool
+// creating it decides about the global thread pools and the shared arena.
+// global_pools receives whether the env has global thread pools.
+static std::shared_ptr<Ort::Env> shared_env(const TtsConfig &config, bool &global_pools) {
+  static std::mutex mutex;
+  static std::weak_ptr<Ort::Env> current;
+  static bool env_global_pools = false;
+  static std::string env_threads;
+  static bool env_arena = false;
+  bool want_arena = config.enable_cpu_mem_arena && config.customArena();
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<Ort::Env> env = current.lock();
+  if (env) {
+    global_pools = env_global_pools;
+    if (config.use_global_thread_pool && !env_global_pools) {
+      std::cout << "Ort::Env already created without global thread pools, "
+                << "the sessions get their own thread pools" << std::endl;
+    } else if (config.use_global_thread_pool && thread_settings(config) != env_threads) {
+      std::cout << "Ort::Env already created with global thread pools of other settings, "
+                << "intra_op_num_threads, inter_op_num_threads, cpu_affinity and "
+                << "allow_spinning of this config are not applied" << std::endl;
+    }
+    if (want_arena && !env_arena) {
+      std::cout << "Ort::Env already created without a shared arena, "
+                << "the arena settings are ignored" << std::endl;
+    }
+    return env;
+  }
+  env = create_env(config);
+  if (want_arena) {
+    register_arena(*env, config);
+  }
+  current = env;
+  global_pools = env_global_pools = config.use_global_thread_pool;
+  env_threads = env_global_pools ? thread_settings(config) : "";
+  env_arena = want_arena;
+  return env;
+}
+
+std::string SessionPool::Stats::toString() const {
+  std::ostringstream os;
+  os << "sessions=" << size << " busy=" << busy << " peak_busy=" << peak_busy
+     << " leases=" << leases << " waits=" << waits << " wait_ms=" << wait_ms;
+  return os.str();
+}
+
+SessionPool::Lease::Lease(Lease &&other) noexcept
+    : _pool(other._pool), _index(other._index) {
+  other._pool = nullptr;
+}
+
+SessionPool::Lease::~Lease() {
+  if (_pool) {
+    _pool->release(_index);
+  }
+}
+
+Ort::Session &SessionPool::Lease::session() {
+  return *_pool->_slots[_index].session;
+}
+
+Ort::IoBinding &SessionPool::Lease::binding() {
+  return *_pool->_slots[_index].binding;
+}
+
+SessionPool::SessionPool(const TtsConfig &config)
+    : _env(shared_env(config, _global_thread_pools)) {}
+
+void SessionPool::addSession(const std::string &model_path,
+                             const Ort::SessionOptions &options) {
+  addSlot(std::make_unique<Ort::Session>(*_env, model_path.c_str(), options,
+                                         _prepacked));
+}
+
+void SessionPool::addSession(const void *model_data, size_t model_size,
+                             const Ort::SessionOptions &options) {
+  addSlot(std::make_unique<Ort::Session>(*_env, model_data, model_size, options,
+                                         _prepacked));
+}
+
+void SessionPool::addSlot(std::unique_ptr<Ort::Session> session) {
+  Slot slot;
+  slot.session = std::move(session);
+  slot.binding = std::make_unique<Ort::IoBinding>(*slot.session);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _idle.push_back(_slots.size());
+  _slots.push_back(std::move(slot));
+  _stats.size = _slots.size();
+  _cond.notify_one();
+}
+
+SessionPool::Lease SessionPool::acquire() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  ++_stats.leases;
+  if (_idle.empty()) {
+    ++_stats.waits;
+    auto start = std::chrono::steady_clock::now();
+    _cond.wait(lock, [this] { return !_idle.empty(); });
+    _stats.wait_ms += std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start).count();
+  }
+  size_t index = _idle.back();
+  _idle.pop_back();
+  ++_stats.busy;
+  _stats.peak_busy = std::max(_stats.peak_busy, _stats.busy);
+  return Lease(this, index);
+}
+
+SessionPool::Lease SessionPool::acquire(size_t index) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  ++_stats.leases;
+  auto idle = [&] { return std::find(_idle.begin(), _idle.end(), index); };
+  if (idle() == _idle.end()) {
+    ++_stats.waits;
+    auto start = std::chrono::steady_clock::now();
+    _cond.wait(lock, [&] { return idle() != _idle.end(); });
+    _stats.wait_ms += std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start).count();
+  }
+  _idle.erase(idle());
+  ++_stats.busy;
+  _stats.peak_busy = std::max(_stats.peak_busy, _stats.busy);
+  return Lease(this, index);
+}
+
+void SessionPool::release(size_t index) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _idle.push_back(index);
+    --_stats.busy;
+  }
+  // a waiter of acquire(index) may want another session than the one woken
+  _cond.notify_all();
+}
+
+SessionPool::Stats SessionPool::stats() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
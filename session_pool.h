@@ -0,0 +1,88 @@
+/*************************************************************************
+    > File Name: session_pool.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月09日 星期一 15时20分44秒
+ ************************************************************************/
+#pragma once
+#include "tts_config.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <onnxruntime_cxx_api.h>
+#include <string>
+#include <vector>
+
+// A fixed set of kokoro sessions created from the Ort::Env of the process.
+// All sessions share a PrepackedWeightsContainer, so the prepacked weights
+// (the bulk of kokoro's MatMul/Conv weights) are held once, and with
+// TtsConfig::use_global_thread_pool they also share the env thread pools
+// instead of spawning their own. A request leases an idle session, together
+// with its IoBinding, for the time of one Run.
+class SessionPool {
+public:
+  struct Stats {
+    size_t size = 0;       // number of sessions
+    size_t busy = 0;       // sessions leased right now
+    size_t peak_busy = 0;  // max of busy since start
+    uint64_t leases = 0;   // number of acquire()
+    uint64_t waits = 0;    // acquire() which found no idle session
+    double wait_ms = 0;    // total time spent waiting for an idle session
+    std::string toString() const;
+  };
+
+  class Lease {
+  public:
+    Lease(Lease &&other) noexcept;
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    ~Lease();
+
+    Ort::Session &session();
+    Ort::IoBinding &binding();
+
+  private:
+    friend class SessionPool;
+    Lease(SessionPool *pool, size_t index) : _pool(pool), _index(index) {}
+    SessionPool *_pool;
+    size_t _index;
+  };
+
+  explicit SessionPool(const TtsConfig &config);
+
+  void addSession(const std::string &model_path, const Ort::SessionOptions &options);
+  // model_data must stay valid as long as the pool
+  void addSession(const void *model_data, size_t model_size,
+                  const Ort::SessionOptions &options);
+  // blocks until a session is idle
+  Lease acquire();
+  // blocks until session index is idle, to reach every session (warmup)
+  Lease acquire(size_t index);
+
+  size_t size() const { return _slots.size(); }
+  // for reading metadata, the session is not leased
+  Ort::Session &session(size_t i) { return *_slots[i].session; }
+  Ort::Env &env() { return *_env; }
+  // the env has global thread pools, pass it to TtsConfig::apply
+  bool globalThreadPools() const { return _global_thread_pools; }
+  Stats stats() const;
+
+private:
+  struct Slot {
+    std::unique_ptr<Ort::Session> session;
+    std::unique_ptr<Ort::IoBinding> binding;
+  };
+  void release(size_t index);
+  void addSlot(std::unique_ptr<Ort::Session> session);
+
+  bool _global_thread_pools = false; // set before _env, see shared_env
+  std::shared_ptr<Ort::Env> _env;
+  Ort::PrepackedWeightsContainer _prepacked;
+  std::vector<Slot> _slots;
+  std::vector<size_t> _idle;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _cond;
+  Stats _stats;
+};
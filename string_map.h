@@ -0,0 +1,127 @@
+/*************************************************************************
+    > File Name: string_map.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月03日 星期四 09时47分18秒
+ ************************************************************************/
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 64 bit FNV-1a, 8 bytes mixed per step like hash_file.
+// The index of a compiled lexicon.bin is built with it: any change to it must
+// bump BinaryLexicon::kVersion.
+inline uint64_t hash_string(std::string_view s) {
+  uint64_t hash = 1469598103934665603ULL;
+  size_t i = 0;
+  for (; i + 8 <= s.size(); i += 8) {
+    uint64_t word;
+    memcpy(&word, s.data() + i, 8);
+    hash = (hash ^ word) * 1099511628211ULL;
+    hash ^= hash >> 29;
+  }
+  for (; i < s.size(); ++i) {
+    hash = (hash ^ (unsigned char)s[i]) * 1099511628211ULL;
+  }
+  return hash ^ (hash >> 32);
+}
+
+// Open addressing hash map from strings to V, for the lexicon and token
+// tables: built once, then only looked up, so there is no erase.
+// Lookups take a std::string_view and do not build a std::string. The keys
+// live in one buffer and the slots are 16 bytes, linear probing at a load
+// factor <= 0.5 usually touches a single cache line.
+template <typename V>
+class StringMap {
+public:
+  StringMap() { rehash(16); }
+
+  // like std::map::operator[], the value of a new key is V()
+  V &operator[](std::string_view key) {
+    if ((_values.size() + 1) * 2 > _slots.size()) {
+      rehash(_slots.size() * 2);
+    }
+    uint64_t hash = hash_string(key);
+    size_t i = probe(key, hash);
+    Slot &slot = _slots[i];
+    if (slot.value == kEmpty) {
+      slot.hash = (uint32_t)hash;
+      slot.value = _values.size();
+      slot.key_offset = _keys.size();
+      slot.key_size = key.size();
+      _keys.append(key.data(), key.size());
+      _values.emplace_back();
+    }
+    return _values[slot.value];
+  }
+
+  // nullptr if key is not in the map
+  const V *find(std::string_view key) const {
+    const Slot &slot = _slots[probe(key, hash_string(key))];
+    return slot.value == kEmpty ? nullptr : &_values[slot.value];
+  }
+
+  size_t size() const { return _values.size(); }
+  bool empty() const { return _values.empty(); }
+
+  // expected number of keys, avoids the rehashes while loading
+  void reserve(size_t n) {
+    size_t capacity = _slots.size();
+    while (capacity < 2 * n) {
+      capacity *= 2;
+    }
+    if (capacity != _slots.size()) {
+      rehash(capacity);
+    }
+    _values.reserve(n);
+  }
+
+private:
+  static constexpr uint32_t kEmpty = UINT32_MAX;
+  struct Slot {
+    uint32_t hash = 0; // low bits of the key hash, compared before the key
+    uint32_t value = kEmpty;
+    uint32_t key_offset = 0;
+    uint32_t key_size = 0;
+  };
+
+  std::string_view key(const Slot &slot) const {
+    return std::string_view(_keys.data() + slot.key_offset, slot.key_size);
+  }
+
+  // slot of key, or the empty slot where it would be inserted
+  size_t probe(std::string_view k, uint64_t hash) const {
+    size_t mask = _slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const Slot &slot = _slots[i];
+      if (slot.value == kEmpty ||
+          (slot.hash == (uint32_t)hash && key(slot) == k)) {
+        return i;
+      }
+    }
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Slot> old;
+    old.swap(_slots);
+    _slots.resize(capacity);
+    size_t mask = capacity - 1;
+    for (const Slot &slot : old) {
+      if (slot.value == kEmpty) {
+        continue;
+      }
+      size_t i = hash_string(key(slot)) & mask;
+      while (_slots[i].value != kEmpty) {
+        i = (i + 1) & mask;
+      }
+      _slots[i] = slot;
+    }
+  }
+
+  std::vector<Slot> _slots; // size is a power of two
+  std::string _keys;
+  std::vector<V> _values;
+};
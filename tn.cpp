@@ -6,6 +6,7 @@
  ************************************************************************/
 
 #include "tn.h"
+#include "utf8.h"
 #include <unordered_set>
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -23,24 +24,7 @@ std::unordered_set<int> sentence_splitter = {
 // use utf-8 Chinese characters
 // no punctuation here!
 inline size_t str_len(const std::string& s) {
-    int strSize = s.size();
-    int i = 0;
-    int cnt = 0;
-    while (i < strSize) {
-        // English letters
-        if (s[i] <= 'z' && s[i] >= 'a' || s[i] <= 'Z' && s[i] >= 'A') {
-            ++cnt;
-            ++i;
-        } else {  // Chinese characters
-            int len = 1;
-            for (int j = 0; j < 6 && (s[i] & (0x80 >> j)); j++) {
-                len = j + 1;
-            }
-            ++cnt;
-            i += len;
-        }
-    }
-    return cnt;
+    return utf8_count(s);
 }
 
 MeloTn::MeloTn(const std::string& model_dir) {
@@ -176,46 +160,33 @@ std::string MeloTn::text_normalize(const std::string& text) {
 // https://sf-zhou.github.io/programming/chinese_encoding.html
 std::string MeloTn::filter_text(const std::string& input) {
     std::string output;
-    size_t i = 0;
-    while (i < input.size()) {
-        unsigned char first_byte = input[i];
-        size_t char_len = 0;
-        unsigned int code_point = 0;
-
-        // determine the length of a character (in UTF-8 encoding)
-        if ((first_byte & 0x80) == 0x00) {  // 1-byte sequence: 0xxxxxxx
-            char_len = 1;
-            code_point = first_byte;
-        } else if ((first_byte & 0xE0) == 0xC0) {  // 2-byte sequence: 110xxxxx 10xxxxxx
-            if (i + 1 >= input.size())
-                break;
-            char_len = 2;
-            code_point = (first_byte & 0x1F) << 6;
-            code_point |= (input[i + 1] & 0x3F);
-        } else if ((first_byte & 0xF0) == 0xE0) {  // 3-byte sequence: 1110xxxx 10xxxxxx 10xxxxxx
-            if (i + 2 >= input.size())
-                break;
-            char_len = 3;
-            code_point = (first_byte & 0x0F) << 12;
-            code_point |= (input[i + 1] & 0x3F) << 6;
-            code_point |= (input[i + 2] & 0x3F);
-        } else if ((first_byte & 0xF8) == 0xF0) {  // 4-byte sequence: 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
-            if (i + 3 >= input.size())
-                break;
-            char_len = 4;
-            code_point = (first_byte & 0x07) << 18;
-            code_point |= (input[i + 1] & 0x3F) << 12;
-            code_point |= (input[i + 2] & 0x3F) << 6;
-            code_point |= (input[i + 3] & 0x3F);
+    output.reserve(input.size());
+    // in an ascii run, the letters, the valid punctuation and the spaces are
+    // kept, appended a span at a time
+    auto ascii_run = [&](std::string_view run) {
+        size_t begin = 0;
+        for (size_t i = 0; i <= run.size(); ++i) {
+            if (i < run.size() && (is_english_char(run[i]) || is_valid_punc(run[i]) || run[i] == ' ')) {
+                continue;
+            }
+            output.append(run.substr(begin, i - begin));
+            begin = i + 1;
+        }
+    };
+    utf8_for_each_run(input, ascii_run, [&](std::string_view ch) {
+        size_t char_len = utf8_len(ch[0]);
+        // a character cut by the end of the text is dropped
+        if (ch.size() < char_len) {
+            return;
         }
+        unsigned int code_point = utf8_decode(ch.data(), char_len);
 
         // Determine if the character is a Simplified Chinese or English character
         // or if it is a valid punctuation mark or space
         if (is_chinese_char(code_point) || is_english_char(code_point) || is_valid_punc(code_point) ||
-            char_len == 1 && first_byte == ' ') {
-            output += input.substr(i, char_len);
+            char_len == 1 && ch[0] == ' ') {
+            output.append(ch);
         }
-        i += char_len;
-    }
+    });
     return output;
 }
@@ -4,7 +4,7 @@
     > Mail: 1216451203@qq.com
     > Created Time: 2025年05月21日 星期三 22时22分21秒
  ************************************************************************/
-
+#pragma once
 #include <vector>
 #include <memory>
 #include <string>
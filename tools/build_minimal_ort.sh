@@ -0,0 +1,46 @@
+#!/bin/bash
+#########################################################################
+# File Name: build_minimal_ort.sh
+# Author: frank
+# mail: 1216451203@qq.com
+# Created Time: 2025年07月02日 星期三 11时20分37秒
+#########################################################################
+# Converts model/kokoro.onnx to the ORT format and builds an onnxruntime with
+# only the operators it needs, then builds infer against it:
+#
+#   pip install onnxruntime==1.17.1
+#   bash tools/build_minimal_ort.sh [model dir, default build/model]
+#
+# The result is build/model/kokoro.ort and a build/bin/infer without protobuf
+# and without the unused kernels.
+set -e
+
+ORT_VERSION=1.17.1
+ROOT=$(cd $(dirname $0)/.. && pwd)
+MODEL_DIR=${1:-$ROOT/build/model}
+ORT_SRC=$ROOT/build_ort_minimal/onnxruntime
+ORT_INSTALL=$ROOT/build_ort_minimal/install
+
+# 1. kokoro.ort and kokoro.required_operators.config next to kokoro.onnx
+python3 -m onnxruntime.tools.convert_onnx_models_to_ort \
+    --optimization_style Fixed $MODEL_DIR/kokoro.onnx
+
+# 2. onnxruntime with those operators only
+if [ ! -d $ORT_SRC ]; then
+    git clone --depth 1 --branch v$ORT_VERSION --recursive \
+        https://github.com/microsoft/onnxruntime.git $ORT_SRC
+fi
+cd $ORT_SRC
+./build.sh --config MinSizeRel --parallel --skip_tests --build_shared_lib \
+    --minimal_build --disable_ml_ops \
+    --include_ops_by_config $MODEL_DIR/kokoro.required_operators.config \
+    --cmake_extra_defines CMAKE_INSTALL_PREFIX=$ORT_INSTALL
+cmake --install build/Linux/MinSizeRel
+# the headers are installed under include/onnxruntime
+cp $ORT_INSTALL/include/onnxruntime/*.h $ORT_INSTALL/include/ 2>/dev/null || true
+
+# 3. infer against it
+mkdir -p $ROOT/build
+cd $ROOT/build
+cmake .. -DKOKORO_ORT_MINIMAL=ON -DKOKORO_ORT_MINIMAL_DIR=$ORT_INSTALL
+make -j 8
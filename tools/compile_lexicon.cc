@@ -0,0 +1,28 @@
+/*************************************************************************
+    > File Name: compile_lexicon.cc
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月04日 星期五 15时10分07秒
+ ************************************************************************/
+// Compiles the text lexicons into the lexicon.bin that TtsModel maps at
+// startup, pass it as the only lexicon file. Run it again whenever
+// tokens.txt or a lexicon changes.
+//
+//   compile_lexicon model/tokens.txt model/lexicon.bin model/lexicon-us-en.txt model/lexicon-zh.txt
+#include "binary_lexicon.h"
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cout << "usage: " << argv[0] << " tokens.txt out.bin lexicon.txt..." << std::endl;
+    return 1;
+  }
+  try {
+    std::vector<std::string> lexicons(argv + 3, argv + argc);
+    BinaryLexicon::compile(lexicons, argv[1], argv[2]);
+  } catch (const std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
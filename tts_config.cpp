@@ -0,0 +1,209 @@
+/*************************************************************************
+    > File Name: tts_config.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月03日 星期二 10时12分31秒
+ ************************************************************************/
+#include "tts_config.h"
+#include "cpu_affinity.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+static int32_t hardware_threads() {
+  int32_t n = std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+TtsConfig TtsConfig::LowLatency() {
+  TtsConfig config;
+  config.mode = kLatency;
+  config.intra_op_num_threads = hardware_threads();
+  config.inter_op_num_threads = 1;
+  config.execution_mode = ORT_SEQUENTIAL;
+  // a waiting request costs more than the cpu burnt by spinning threads
+  config.allow_spinning = true;
+  // a per session arena that keeps what it grew, so a request never waits
+  // for the system allocator
+  config.enable_cpu_mem_arena = true;
+  config.enable_mem_pattern = true;
+  config.arena_shrink_tokens = 0;
+  config.num_sessions = 1;
+  config.max_batch_size = 1;
+  config.batch_window_ms = 0;
+  config.stream_first_chunk_bytes = 30;
+  config.stream_chunk_bytes = 300;
+  return config;
+}
+
+TtsConfig TtsConfig::Throughput(int32_t sessions_per_host) {
+  TtsConfig config;
+  config.mode = kThroughput;
+  sessions_per_host = std::max(1, sessions_per_host);
+  config.intra_op_num_threads = std::max(1, hardware_threads() / sessions_per_host);
+  config.inter_op_num_threads = 1;
+  config.execution_mode = ORT_SEQUENTIAL;
+  // many sessions keep the cores busy, spinning would steal from the others
+  config.allow_spinning = false;
+  // one arena shared by all the sessions, extended by what is requested
+  // only, and shrunk after long Runs so the many sessions do not each keep
+  // the peak of their longest request
+  config.enable_cpu_mem_arena = true;
+  config.enable_mem_pattern = true;
+  config.arena_extend_strategy = 1;
+  config.arena_shrink_tokens = 256;
+  config.num_sessions = sessions_per_host;
+  config.async_workers = sessions_per_host;
+  config.async_queue_depth = 4 * sessions_per_host;
+  config.max_batch_size = 8;
+  config.batch_window_ms = 20;
+  // No short first chunk, every Run close to _max_len: 300 bytes of hanzi
+  // (100 characters, a few phoneme tokens each) come near the 510 tokens,
+  // a longer chunk would be cut again by splitTokens at any point.
+  config.stream_first_chunk_bytes = 300;
+  config.stream_chunk_bytes = 300;
+  return config;
+}
+
+TtsConfig TtsConfig::ForMode(Mode mode, int32_t sessions) {
+  switch (mode) {
+  case kLatency:
+    return LowLatency();
+  case kThroughput:
+    return Throughput(sessions > 0 ? sessions : hardware_threads());
+  default:
+    return TtsConfig();
+  }
+}
+
+TtsConfig TtsConfig::FromPreset(const std::string &name) {
+  if (name.empty() || name == "default") {
+    return TtsConfig();
+  }
+  if (name == "low_latency") {
+    return ForMode(kLatency);
+  }
+  if (name == "throughput") {
+    return ForMode(kThroughput);
+  }
+  const std::string prefix = "throughput:";
+  if (name.compare(0, prefix.size(), prefix) == 0) {
+    return Throughput(std::stoi(name.substr(prefix.size())));
+  }
+  throw std::invalid_argument("unknown tts preset: " + name);
+}
+
+void TtsConfig::apply(Ort::SessionOptions &options, bool env_thread_pools) const {
+  // ORT fails to create a session without own threads in an env without pools
+  if (use_global_thread_pool && env_thread_pools) {
+    // the thread numbers go to the Ort::Env, see SessionPool
+    options.DisablePerSessionThreads();
+  } else {
+    options.SetIntraOpNumThreads(intraOpThreads());
+    options.SetInterOpNumThreads(inter_op_num_threads);
+    std::string affinity = ort_thread_affinity(affinityCpus(), intraOpThreads());
+    if (!affinity.empty()) {
+      options.AddConfigEntry("session.intra_op_thread_affinities", affinity.c_str());
+    }
+    if (!allow_spinning) {
+      options.AddConfigEntry("session.intra_op.allow_spinning", "0");
+      options.AddConfigEntry("session.inter_op.allow_spinning", "0");
+    }
+  }
+  options.SetGraphOptimizationLevel(graph_optimization_level);
+  options.SetExecutionMode(execution_mode);
+  if (enable_mem_pattern) {
+    options.EnableMemPattern();
+  } else {
+    options.DisableMemPattern();
+  }
+  if (enable_cpu_mem_arena) {
+    options.EnableCpuMemArena();
+    if (customArena()) {
+      // the arena registered by SessionPool
+      options.AddConfigEntry("session.use_env_allocators", "1");
+    }
+  } else {
+    options.DisableCpuMemArena();
+  }
+}
+
+bool TtsConfig::customArena() const {
+  return arena_max_mem > 0 || arena_extend_strategy >= 0 || arena_initial_chunk_bytes >= 0;
+}
+
+std::vector<int32_t> TtsConfig::affinityCpus() const {
+  if (!cpu_affinity.empty() || numa_node < 0) {
+    return cpu_affinity;
+  }
+  std::vector<int32_t> cpus = numa_node_cpus(numa_node);
+  if (cpus.empty()) {
+    throw std::invalid_argument("no cpus found for numa node " + std::to_string(numa_node));
+  }
+  return cpus;
+}
+
+int32_t TtsConfig::intraOpThreads() const {
+  if (intra_op_num_threads > 0) {
+    return intra_op_num_threads;
+  }
+  // ORT only pins threads it was told the number of
+  return affinityCpus().size();
+}
+
+void TtsConfig::pinWorkerThread() const {
+  std::vector<int32_t> cpus = affinityCpus();
+  if (!cpus.empty()) {
+    pin_current_thread(cpus);
+  }
+}
+
+std::string TtsConfig::graphOptions() const {
+  std::ostringstream os;
+  os << "level=" << graph_optimization_level
+     << " execution_mode=" << execution_mode
+     << " provider=cpu";
+  return os.str();
+}
+
+std::string TtsConfig::toString() const {
+  std::ostringstream os;
+  const char *modes[] = {"default", "latency", "throughput"};
+  os << "mode=" << modes[mode]
+     << " intra_op_num_threads=" << intra_op_num_threads
+     << " inter_op_num_threads=" << inter_op_num_threads
+     << " graph_optimization_level=" << graph_optimization_level
+     << " execution_mode=" << (execution_mode == ORT_PARALLEL ? "parallel" : "sequential")
+     << " mem_pattern=" << enable_mem_pattern
+     << " cpu_mem_arena=" << enable_cpu_mem_arena
+     << " arena_max_mem=" << arena_max_mem
+     << " arena_extend_strategy=" << arena_extend_strategy
+     << " arena_initial_chunk_bytes=" << arena_initial_chunk_bytes
+     << " arena_shrink_tokens=" << arena_shrink_tokens
+     << " num_sessions=" << num_sessions
+     << " global_thread_pool=" << use_global_thread_pool
+     << " numa_node=" << numa_node
+     << " allow_spinning=" << allow_spinning
+     << " max_batch_size=" << max_batch_size
+     << " batch_window_ms=" << batch_window_ms
+     << " optimized_model_dir=" << optimized_model_dir
+     << " use_mmap=" << use_mmap
+     << " decoder_model=" << decoder_model
+     << " decoder_window_frames=" << decoder_window_frames
+     << " decoder_overlap_frames=" << decoder_overlap_frames
+     << " async_workers=" << async_workers
+     << " async_queue_depth=" << async_queue_depth
+     << " stream_chunk_bytes=" << stream_first_chunk_bytes << "/" << stream_chunk_bytes
+     << " g2p_cache_bytes=" << g2p_cache_bytes
+     << " warmup_on_start=" << warmup_on_start
+     << " bucket_lengths=";
+  for (size_t i = 0; i < bucket_lengths.size(); ++i) {
+    os << (i ? "," : "") << bucket_lengths[i];
+  }
+  os << " cpu_affinity=";
+  for (size_t i = 0; i < cpu_affinity.size(); ++i) {
+    os << (i ? "," : "") << cpu_affinity[i];
+  }
+  return os.str();
+}
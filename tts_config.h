@@ -0,0 +1,141 @@
+/*************************************************************************
+    > File Name: tts_config.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月03日 星期二 10时12分07秒
+ ************************************************************************/
+#pragma once
+#include <onnxruntime_cxx_api.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runtime settings of the kokoro session.
+// The defaults keep the ORT defaults (intra-op threads picked by ORT), use the
+// presets below when several processes/sessions share one host.
+struct TtsConfig {
+  // the goal the settings were picked for, see ForMode
+  enum Mode { kDefault, kLatency, kThroughput };
+  Mode mode = kDefault;
+
+  int32_t intra_op_num_threads = 0; // 0: let ORT decide (one per core)
+  int32_t inter_op_num_threads = 1;
+  GraphOptimizationLevel graph_optimization_level = ORT_ENABLE_ALL;
+  ExecutionMode execution_mode = ORT_SEQUENTIAL;
+  bool enable_mem_pattern = true;
+  bool enable_cpu_mem_arena = true;
+  // CPU arena settings. If any is set, one arena with them is registered in
+  // the Ort::Env and shared by all the sessions (session.use_env_allocators)
+  // instead of a default arena per session.
+  size_t arena_max_mem = 0;               // bytes, 0: no limit
+  int32_t arena_extend_strategy = -1;     // -1: ORT default, 0: next power of two, 1: same as requested
+  int32_t arena_initial_chunk_bytes = -1; // -1: ORT default
+  // After a Run of at least arena_shrink_tokens tokens the arena hands its
+  // unused chunks back to the system, so one long request does not keep the
+  // RSS up for the life of the process. 0: never shrink.
+  int32_t arena_shrink_tokens = 0;
+  // number of sessions in the SessionPool, i.e. how many Run can be in flight
+  // at the same time. Set it to the number of worker threads.
+  int32_t num_sessions = 1;
+  // sessions use the thread pools of the Ort::Env (sized by the thread
+  // numbers above) instead of creating one pool each. There is one Ort::Env
+  // per process, shared by all the models, so the first model loaded sets
+  // up the global pools: a later model with use_global_thread_pool uses them
+  // as they are (its thread numbers, cpu_affinity and allow_spinning are not
+  // applied), and if the env was created without global pools its sessions
+  // get their own thread pools as if use_global_thread_pool were false.
+  bool use_global_thread_pool = false;
+  // Pin the intra-op pool threads, one per cpu, and the request worker
+  // threads (BatchScheduler, TtsExecutor, ...) to these cpus, e.g. the cores
+  // of one socket so that threads do not migrate across sockets. Empty: the
+  // cpus of numa_node if it is >= 0, else no pinning.
+  std::vector<int32_t> cpu_affinity;
+  int32_t numa_node = -1;
+  // false: idle pool threads sleep instead of spinning, which saves power
+  // between requests at the cost of some wake-up latency
+  bool allow_spinning = true;
+  // BatchScheduler: requests arriving within batch_window_ms of the oldest
+  // waiting one are run together, up to max_batch_size (and the batch size
+  // the model was exported with) per Run
+  int32_t max_batch_size = 1;
+  int32_t batch_window_ms = 5;
+  // token lengths, e.g. {32, 64, 128, 256, 510}, sorted by TtsModel. If not
+  // empty, the tokens of a run are padded up to the next bucket so that ORT
+  // sees a few shapes only and reuses its memory plans. Needs a model with
+  // the 'durations' output to cut the padding from the audio: the stock
+  // kokoro.onnx has none, bucketing is then turned off (TtsModel::_bucketing
+  // is false) with a single log line.
+  // Quality trade-off: the padding is token 0 and kokoro takes no attention
+  // mask, so the real tokens also attend to the padding and the prosody and
+  // durations of the whole utterance may change, not only the cut tail. Check
+  // the difference with bench_bucket before enabling it; the presets leave it
+  // empty.
+  std::vector<int32_t> bucket_lengths;
+  // run TtsContext::warmup() at the end of the TtsModel constructor
+  bool warmup_on_start = false;
+  // voices to warm up, empty for all the voices of voices.bin
+  std::vector<std::string> warmup_voices;
+  // if not empty, the ORT-optimized graph is written to this directory on the
+  // first start and loaded from there afterwards (keyed on model hash, ORT
+  // version and graphOptions()). The cached graph may contain hardware specific kernels, so only
+  // share the directory between hosts of the same cpu type. Not used for
+  // ORT format (.ort) models, they are optimized when converted.
+  std::string optimized_model_dir;
+  // build the sessions from a read-only mmap of the model and keep voices.bin
+  // as a mmap view instead of heap copies, so that processes on the same host
+  // share one copy in the page cache
+  bool use_mmap = false;
+  // Two-stage export: if not empty, the kokoro model given to TtsModel is the
+  // text encoder / duration predictor and this one the decoder (vocoder).
+  // The decoder runs over windows of decoder_window_frames frames, which
+  // overlap by decoder_overlap_frames frames that are crossfaded, and the
+  // audio of every window is emitted as soon as it is decoded.
+  std::string decoder_model;
+  int32_t decoder_window_frames = 40; // 1s of audio at 40 frames per second
+  int32_t decoder_overlap_frames = 4;
+  // TtsExecutor (Tts::runAsync): worker threads, 0 for one per session, and
+  // requests waiting for a worker before runAsync rejects new ones
+  int32_t async_workers = 0;
+  int32_t async_queue_depth = 16;
+  // TtsPipeline chunk sizes: the first chunk closes at the first phrase
+  // boundary past stream_first_chunk_bytes, the limit then doubles per chunk
+  // up to stream_chunk_bytes
+  int32_t stream_first_chunk_bytes = 30;
+  int32_t stream_chunk_bytes = 300;
+  // memory cap of the G2pCache (hanzi segment -> token ids) shared by the
+  // contexts of a model, 0 to disable it
+  size_t g2p_cache_bytes = 8 << 20;
+
+  // One request at a time, all cores work on it with spinning threads, no
+  // batching window, a short first stream chunk and an arena that is never
+  // shrunk.
+  static TtsConfig LowLatency();
+  // sessions_per_host sessions in this process, cores split evenly between
+  // them so they do not oversubscribe the machine, threads sleep instead of
+  // spinning, requests are batched and streamed in long chunks only, and the
+  // sessions share one arena that is shrunk after long Runs.
+  static TtsConfig Throughput(int32_t sessions_per_host);
+  // kLatency: LowLatency(), kThroughput: Throughput(sessions), sessions <= 0
+  // for one session per core
+  static TtsConfig ForMode(Mode mode, int32_t sessions = 0);
+  // "default", "low_latency", "throughput" or "throughput:<sessions_per_host>"
+  static TtsConfig FromPreset(const std::string &name);
+
+  // env_thread_pools: the Ort::Env of the sessions has global thread pools
+  // (SessionPool::globalThreadPools), without them the sessions always get
+  // their own pools
+  void apply(Ort::SessionOptions &options, bool env_thread_pools) const;
+  // one of the arena_* settings differs from the ORT default
+  bool customArena() const;
+  // cpu_affinity, or the cpus of numa_node; empty for no pinning
+  std::vector<int32_t> affinityCpus() const;
+  // intra-op threads to run, intra_op_num_threads or, when it is left to ORT
+  // but the threads are pinned, one per pinned cpu
+  int32_t intraOpThreads() const;
+  // pin the calling worker thread to affinityCpus(), if any
+  void pinWorkerThread() const;
+  std::string toString() const;
+  // the settings that change the graph ORT optimizes (optimization level,
+  // execution mode and provider), part of the optimized_model_dir cache key
+  std::string graphOptions() const;
+};
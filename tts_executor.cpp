@@ -0,0 +1,91 @@
+/*************************************************************************
+    > File Name: tts_executor.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月26日 星期四 16时22分05秒
+ ************************************************************************/
+#include "tts_executor.h"
+#include <algorithm>
+
+TtsExecutor::TtsExecutor(std::shared_ptr<const TtsModel> model)
+    : _model(std::move(model)),
+      _queue(std::max(1, _model->_config.async_queue_depth)) {
+  int32_t num_workers = _model->_config.async_workers;
+  if (num_workers <= 0) {
+    num_workers = std::max<int32_t>(1, _model->_sessions->size());
+  }
+  for (int32_t i = 0; i < num_workers; ++i) {
+    _workers.emplace_back(&TtsExecutor::worker, this);
+  }
+}
+
+TtsExecutor::~TtsExecutor() {
+  _queue.close();
+  for (auto &t : _workers) {
+    t.join();
+  }
+}
+
+std::future<std::vector<float>>
+TtsExecutor::runAsync(const std::string &text, const std::string &voice,
+                      CancellationToken *cancel) {
+  auto promise = std::make_shared<std::promise<std::vector<float>>>();
+  auto future = promise->get_future();
+  bool accepted = submit([=](TtsContext &context) {
+    try {
+      std::vector<float> audio;
+      context.run(text, voice, audio, cancel);
+      promise->set_value(std::move(audio));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  });
+  if (!accepted) {
+    promise->set_exception(std::make_exception_ptr(TtsQueueFull()));
+  }
+  return future;
+}
+
+bool TtsExecutor::runAsync(const std::string &text, const std::string &voice,
+                           Callback done, CancellationToken *cancel) {
+  return submit([=](TtsContext &context) {
+    std::vector<float> audio;
+    std::exception_ptr error;
+    try {
+      context.run(text, voice, audio, cancel);
+    } catch (...) {
+      error = std::current_exception();
+      audio.clear();
+    }
+    done(std::move(audio), error);
+  });
+}
+
+bool TtsExecutor::submit(Job job) {
+  if (!_queue.tryPush(job)) {
+    ++_rejected;
+    return false;
+  }
+  ++_accepted;
+  return true;
+}
+
+TtsExecutor::Stats TtsExecutor::stats() const {
+  Stats stats;
+  stats.accepted = _accepted;
+  stats.rejected = _rejected;
+  stats.completed = _completed;
+  stats.queued = _queue.size();
+  return stats;
+}
+
+void TtsExecutor::worker() {
+  _model->_config.pinWorkerThread();
+  TtsContext context(_model);
+  Job job;
+  while (_queue.pop(job)) {
+    job(context);
+    job = nullptr; // release the captures before waiting again
+    ++_completed;
+  }
+}
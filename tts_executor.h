@@ -0,0 +1,72 @@
+/*************************************************************************
+    > File Name: tts_executor.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月26日 星期四 16时21分33秒
+ ************************************************************************/
+#pragma once
+#include "bounded_queue.h"
+#include "kokoro.h"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the executor queue was full, the request was not started
+class TtsQueueFull : public std::runtime_error {
+public:
+  TtsQueueFull() : std::runtime_error("tts queue full") {}
+};
+
+// Runs text -> audio requests on a fixed set of worker threads, each with its
+// own TtsContext, so an event loop can submit without blocking and without a
+// thread per request in flight. Requests wait in a queue of
+// TtsConfig::async_queue_depth; when it is full runAsync rejects instead of
+// blocking, that is the backpressure the caller sees (retry later, shed, or
+// answer 503). The destructor finishes the queued requests.
+class TtsExecutor {
+public:
+  // audio of the request, or error set (then audio is empty)
+  using Callback = std::function<void(std::vector<float> audio, std::exception_ptr error)>;
+
+  struct Stats {
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;  // queue full
+    uint64_t completed = 0; // finished, with audio or an error
+    size_t queued = 0;      // waiting for a worker right now
+  };
+
+  explicit TtsExecutor(std::shared_ptr<const TtsModel> model);
+  ~TtsExecutor();
+  TtsExecutor(const TtsExecutor &) = delete;
+  TtsExecutor &operator=(const TtsExecutor &) = delete;
+
+  // never blocks; if the queue is full the future holds TtsQueueFull.
+  // cancel, if any, must stay valid until the future is ready
+  std::future<std::vector<float>> runAsync(const std::string &text,
+                                           const std::string &voice,
+                                           CancellationToken *cancel = nullptr);
+  // never blocks; false if the queue is full, done is not called then.
+  // done runs on a worker thread, keep it short and do not throw
+  bool runAsync(const std::string &text, const std::string &voice, Callback done,
+                CancellationToken *cancel = nullptr);
+
+  size_t workers() const { return _workers.size(); }
+  Stats stats() const;
+
+private:
+  using Job = std::function<void(TtsContext &)>;
+  bool submit(Job job);
+  void worker();
+
+  std::shared_ptr<const TtsModel> _model;
+  BoundedQueue<Job> _queue;
+  std::atomic<uint64_t> _accepted{0};
+  std::atomic<uint64_t> _rejected{0};
+  std::atomic<uint64_t> _completed{0};
+  std::vector<std::thread> _workers;
+};
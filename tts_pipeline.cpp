@@ -0,0 +1,165 @@
+/*************************************************************************
+    > File Name: tts_pipeline.cpp
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月23日 星期一 10时43分02秒
+ ************************************************************************/
+#include "tts_pipeline.h"
+#include "bounded_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+double TtsPipeline::Stats::rtf(int32_t sample_rate) const {
+  double audio_ms = samples * 1000.0 / sample_rate;
+  return audio_ms > 0 ? total_ms / audio_ms : 0;
+}
+
+std::string TtsPipeline::Stats::toString(int32_t sample_rate) const {
+  std::ostringstream os;
+  os << "ttfa " << ttfa_ms << " ms, total " << total_ms << " ms, chunks " << chunks
+     << ", audio " << samples * 1000.0 / sample_rate << " ms, rtf " << rtf(sample_rate);
+  return os.str();
+}
+
+TtsPipeline::TtsPipeline(std::shared_ptr<const TtsModel> model, MeloTn &tn)
+    : _model(std::move(model)), _tn(tn), _g2p_context(_model),
+      _infer_context(_model) {
+  _options.first_chunk_bytes = std::max(1, _model->_config.stream_first_chunk_bytes);
+  _options.chunk_bytes = std::max(1, _model->_config.stream_chunk_bytes);
+}
+
+TtsPipeline::TtsPipeline(std::shared_ptr<const TtsModel> model, MeloTn &tn,
+                         const Options &options)
+    : _model(std::move(model)), _tn(tn), _options(options),
+      _g2p_context(_model), _infer_context(_model) {}
+
+std::vector<std::string>
+TtsPipeline::mergePieces(const std::vector<std::string> &pieces,
+                         size_t first_chunk_bytes, size_t chunk_bytes) {
+  std::vector<std::string> chunks;
+  std::string merged = "";
+  size_t limit = std::min(first_chunk_bytes, chunk_bytes);
+  for (auto &p : pieces) {
+    // do a simple merge by . ? !
+    merged += p;
+    if (merged.empty()) {
+      continue;
+    }
+    auto b = merged.back();
+    if (merged.size() >= limit or b == '.' or b == '?' or b == '!') {
+      chunks.push_back(std::move(merged));
+      merged = "";
+      limit = std::min(limit * 2, chunk_bytes);
+    }
+  }
+  if (merged.size() > 0) {
+    chunks.push_back(std::move(merged));
+  }
+  return chunks;
+}
+
+TtsPipeline::Stats TtsPipeline::run(const std::string &text, const std::string &voice,
+                                    std::vector<float> &out_audio,
+                                    CancellationToken *cancel) {
+  return run(text, voice, [&](const float *samples, size_t n) {
+    out_audio.insert(out_audio.end(), samples, samples + n);
+  }, cancel);
+}
+
+TtsPipeline::Stats TtsPipeline::run(const std::string &text, const std::string &voice,
+                                    const Sink &sink, CancellationToken *cancel) {
+  _model->voice(voice); // fail before starting the stages
+  auto start = std::chrono::steady_clock::now();
+  auto since_start = [&start] {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start).count();
+  };
+  Stats stats;
+
+  BoundedQueue<std::string> normalized(_options.queue_depth);
+  BoundedQueue<std::vector<int64_t>> tokens(_options.queue_depth);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto fail = [&](std::exception_ptr e) {
+    {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) {
+        error = e;
+      }
+    }
+    normalized.close();
+    tokens.close();
+  };
+
+  std::thread normalize_stage([&] {
+    try {
+      _model->_config.pinWorkerThread();
+      auto pieces = _tn.split_sentences_into_pieces(text, true);
+      auto chunks = mergePieces(pieces, _options.first_chunk_bytes, _options.chunk_bytes);
+      for (auto &chunk : chunks) {
+        if (cancel) cancel->check();
+        if (!normalized.push(_tn.text_normalize(chunk))) {
+          break; // a later stage failed
+        }
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    normalized.close();
+  });
+
+  std::thread g2p_stage([&] {
+    try {
+      _model->_config.pinWorkerThread();
+      std::string chunk;
+      std::vector<std::vector<int64_t>> ids;
+      bool open = true;
+      while (open && normalized.pop(chunk)) {
+        if (cancel) cancel->check();
+        // a chunk longer than _max_len tokens is split, not truncated
+        _g2p_context.tokenizeChunks(chunk, ids);
+        for (auto &part : ids) {
+          if (!tokens.push(std::move(part))) {
+            open = false;
+            break;
+          }
+        }
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    tokens.close();
+  });
+
+  try {
+    // a two-stage model hands out the audio of a chunk window by window
+    auto emit = [&](const float *samples, size_t n) {
+      if (stats.samples == 0) {
+        stats.ttfa_ms = since_start();
+      }
+      stats.samples += n;
+      sink(samples, n);
+    };
+    std::vector<int64_t> ids;
+    while (tokens.pop(ids)) {
+      _infer_context.inferStream(ids.data(), ids.size(),
+                                 _model->styleFor(voice, ids.size()), 0.85f, emit,
+                                 cancel);
+      ++stats.chunks;
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+
+  normalize_stage.join();
+  g2p_stage.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  stats.total_ms = since_start();
+  return stats;
+}
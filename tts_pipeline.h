@@ -0,0 +1,74 @@
+/*************************************************************************
+    > File Name: tts_pipeline.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年06月23日 星期一 10时42分31秒
+ ************************************************************************/
+#pragma once
+#include "kokoro.h"
+#include "tn.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Text to audio in three stages connected by bounded queues:
+//   normalize: split into chunks + MeloTn::text_normalize  (own thread)
+//   g2p:       TtsContext::tokenize                        (own thread)
+//   inference: ORT Run                                     (calling thread)
+// so the regex heavy front end of chunk n+1 runs while chunk n is in
+// session Run. The audio of every chunk goes to the sink, in text order, as
+// soon as the chunk is synthesized.
+// The first chunk is closed at the first phrase boundary past
+// first_chunk_bytes, so playback can start after one short Run, the limit
+// then doubles per chunk up to chunk_bytes where a Run is efficient and the
+// prosody has a whole sentence to work with. Later chunks are produced while
+// the earlier ones play.
+// MeloTn is not thread safe, do not share one between pipelines running at
+// the same time.
+class TtsPipeline {
+public:
+  using Sink = AudioSink;
+
+  struct Options {
+    size_t queue_depth = 4;         // chunks buffered between two stages
+    size_t first_chunk_bytes = 30;  // about 10 chinese characters
+    size_t chunk_bytes = 300;
+  };
+
+  struct Stats {
+    double ttfa_ms = 0;   // run() start to the first sink call
+    double total_ms = 0;
+    size_t chunks = 0;
+    size_t samples = 0;
+    double rtf(int32_t sample_rate) const;
+    std::string toString(int32_t sample_rate) const;
+  };
+
+  // chunk sizes from TtsConfig::stream_first_chunk_bytes/stream_chunk_bytes
+  TtsPipeline(std::shared_ptr<const TtsModel> model, MeloTn &tn);
+  TtsPipeline(std::shared_ptr<const TtsModel> model, MeloTn &tn,
+              const Options &options);
+
+  // cancel is checked by every stage between two chunks and terminates the
+  // Run in flight, run() throws TtsCancelled then
+  Stats run(const std::string &text, const std::string &voice, const Sink &sink,
+            CancellationToken *cancel = nullptr);
+  // append all the audio to out_audio
+  Stats run(const std::string &text, const std::string &voice,
+            std::vector<float> &out_audio, CancellationToken *cancel = nullptr);
+
+  // merge the sentences of MeloTn::split_sentences_into_pieces into chunks,
+  // closed at . ? ! or once they reach the limit, which starts at
+  // first_chunk_bytes and doubles per chunk up to chunk_bytes
+  static std::vector<std::string> mergePieces(const std::vector<std::string> &pieces,
+                                              size_t first_chunk_bytes = 300,
+                                              size_t chunk_bytes = 300);
+
+private:
+  std::shared_ptr<const TtsModel> _model;
+  MeloTn &_tn;
+  Options _options;
+  TtsContext _g2p_context;
+  TtsContext _infer_context;
+};
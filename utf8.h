@@ -0,0 +1,129 @@
+/*************************************************************************
+    > File Name: utf8.h
+    > Author: frank
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年07月07日 星期一 10时05分33秒
+ ************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// The utf8 walks of the front end (kokoro.cpp, tn.cpp). Text is mostly
+// ascii or mostly 3 byte hanzi, so the ascii runs are found 16 or 32 bytes
+// at a time and only the other characters are decoded one by one.
+// Malformed input is not rejected: a stray continuation byte is a character
+// of length 1 and a character cut by the end of the text is shortened.
+
+// byte length of the character starting with lead, from its leading 1 bits
+inline size_t utf8_len(unsigned char lead) {
+  if (lead >= 0xFC) // lenght 6
+    return 6;
+  else if (lead >= 0xF8)
+    return 5;
+  else if (lead >= 0xF0)
+    return 4;
+  else if (lead >= 0xE0)
+    return 3;
+  else if (lead >= 0xC0)
+    return 2;
+  return 1;
+}
+
+// number of ascii bytes s[0, n) starts with
+inline size_t ascii_prefix(const char *s, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+    uint32_t high = (uint32_t)_mm256_movemask_epi8(v); // the top bit of every byte
+    if (high != 0) {
+      return i + __builtin_ctz(high);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+    uint32_t high = (uint32_t)_mm_movemask_epi8(v);
+    if (high != 0) {
+      return i + __builtin_ctz(high);
+    }
+  }
+#endif
+  while (i < n && (unsigned char)s[i] < 0x80) {
+    ++i;
+  }
+  return i;
+}
+
+// Walks s in order: on_ascii_run(std::string_view run) gets every maximal
+// run of ascii bytes at once, on_char(std::string_view character) every
+// other character. The views point into s.
+template <typename A, typename C>
+inline void utf8_for_each_run(std::string_view s, A &&on_ascii_run, C &&on_char) {
+  size_t i = 0;
+  while (i < s.size()) {
+    if ((unsigned char)s[i] < 0x80) {
+      size_t len = ascii_prefix(s.data() + i, s.size() - i);
+      on_ascii_run(s.substr(i, len));
+      i += len;
+    } else {
+      size_t len = std::min(utf8_len(s[i]), s.size() - i);
+      on_char(s.substr(i, len));
+      i += len;
+    }
+  }
+}
+
+// f(std::string_view character) for every character of s, for the walks
+// over hanzi, see utf8_for_each_run for mostly ascii text
+template <typename F>
+inline void utf8_for_each(std::string_view s, F &&f) {
+  utf8_for_each_run(
+      s,
+      [&](std::string_view run) {
+        for (size_t i = 0; i < run.size(); ++i) {
+          f(run.substr(i, 1));
+        }
+      },
+      f);
+}
+
+// number of characters of s
+inline size_t utf8_count(std::string_view s) {
+  size_t count = 0;
+  size_t i = 0;
+  while (i < s.size()) {
+    size_t ascii = ascii_prefix(s.data() + i, s.size() - i);
+    count += ascii;
+    i += ascii;
+    if (i < s.size()) {
+      i += utf8_len(s[i]);
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Code point of the character of length len (see utf8_len) at s, 0 for
+// the lengths above 4, which are not in unicode.
+inline uint32_t utf8_decode(const char *s, size_t len) {
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(s);
+  switch (len) {
+  case 1:
+    return p[0];
+  case 2:
+    return (p[0] & 0x1F) << 6 | (p[1] & 0x3F);
+  case 3:
+    return (p[0] & 0x0F) << 12 | (p[1] & 0x3F) << 6 | (p[2] & 0x3F);
+  case 4:
+    return (p[0] & 0x07) << 18 | (p[1] & 0x3F) << 12 | (p[2] & 0x3F) << 6 |
+           (p[3] & 0x3F);
+  }
+  return 0;
+}
@@ -4,6 +4,7 @@
 
 #include "wave-writer.h"
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <string>
@@ -35,8 +36,7 @@ int64_t WaveFileSize(int32_t n_samples) {
   return sizeof(WaveHeader) + n_samples * sizeof(int16_t);
 }
 
-void WriteWave(char *buffer, int32_t sampling_rate, const float *samples,
-               int32_t n) {
+static WaveHeader MakeWaveHeader(int32_t sampling_rate, int32_t n) {
   WaveHeader header{};
   header.chunk_id = 0x46464952;      // FFIR
   header.format = 0x45564157;        // EVAW
@@ -55,28 +55,43 @@ void WriteWave(char *buffer, int32_t sampling_rate, const float *samples,
   header.subchunk2_size = n * num_channels * bits_per_sample / 8;
 
   header.chunk_size = 36 + header.subchunk2_size;
+  return header;
+}
 
-  std::vector<int16_t> samples_int16(n);
+// convert [-1, 1] floats to int16 directly into the destination,
+// the destination may not be 2 bytes aligned
+static void FloatToInt16(const float *samples, int32_t n, char *dst) {
   for (int32_t i = 0; i != n; ++i) {
-    samples_int16[i] = samples[i] * 32767;
+    int16_t s = samples[i] * 32767;
+    memcpy(dst + i * sizeof(int16_t), &s, sizeof(int16_t));
   }
+}
 
+void WriteWave(char *buffer, int32_t sampling_rate, const float *samples,
+               int32_t n) {
+  WaveHeader header = MakeWaveHeader(sampling_rate, n);
   memcpy(buffer, &header, sizeof(WaveHeader));
-  memcpy(buffer + sizeof(WaveHeader), samples_int16.data(),
-         n * sizeof(int16_t));
+  FloatToInt16(samples, n, buffer + sizeof(WaveHeader));
 }
 
 bool WriteWave(const std::string &filename, int32_t sampling_rate,
                const float *samples, int32_t n) {
-  std::string buffer;
-  buffer.resize(WaveFileSize(n));
-  WriteWave(buffer.data(), sampling_rate, samples, n);
   std::ofstream os(filename, std::ios::binary);
   if (!os) {
     printf("Failed to create %s", filename.c_str());
     return false;
   }
-  os << buffer;
+  WaveHeader header = MakeWaveHeader(sampling_rate, n);
+  os.write(reinterpret_cast<const char *>(&header), sizeof(WaveHeader));
+
+  // convert block by block instead of building the whole file in memory
+  constexpr int32_t kBlock = 8192;
+  char block[kBlock * sizeof(int16_t)];
+  for (int32_t i = 0; i < n && os; i += kBlock) {
+    int32_t m = std::min(kBlock, n - i);
+    FloatToInt16(samples + i, m, block);
+    os.write(block, m * sizeof(int16_t));
+  }
   if (!os) {
     printf("Write %s failed", filename.c_str());
     return false;